@@ -1,11 +1,14 @@
 // cl_colorizer.cpp
 #include "cl_colorizer.h"
+#include "palette.h"
+#include "program_cache.h"
 #include <cstring>
 #include <iostream>
 
-bool CLColorizer::init(uint32_t w, uint32_t h, const char* src)
+bool CLColorizer::init(uint32_t w, uint32_t h, uint32_t numSpecies, const char* src)
 {
     N = w * h;
+    species_palette(numSpecies, palette);
 
     cl_int err = CL_SUCCESS;
 
@@ -51,22 +54,10 @@ bool CLColorizer::init(uint32_t w, uint32_t h, const char* src)
         return false;
     }
 
-    const char* srcs[] = { src };
-    size_t lens[] = { std::strlen(src) };
-    program = clCreateProgramWithSource(context, 1, srcs, lens, &err);
-    if (!program || err != CL_SUCCESS) {
-        std::cerr << "Failed to create CPU program\n";
-        return false;
-    }
-
-    err = clBuildProgram(program, 1, &device, nullptr, nullptr, nullptr);
-    if (err != CL_SUCCESS) {
-        size_t logSize = 0;
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
-        std::vector<char> log(logSize);
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG,
-            logSize, log.data(), nullptr);
-        std::cerr << "CPU program build log:\n" << log.data() << "\n";
+    std::string log;
+    program = build_program(context, device, src, nullptr, log);
+    if (!program) {
+        std::cerr << "CPU program build log:\n" << log << "\n";
         return false;
     }
 
@@ -80,7 +71,11 @@ bool CLColorizer::init(uint32_t w, uint32_t h, const char* src)
         N * sizeof(cl_uchar), nullptr, &err);
     bufImage = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
         N * 4 * sizeof(cl_uchar), nullptr, &err);
-    if (!bufGrid || !bufImage || err != CL_SUCCESS) {
+    if (err == CL_SUCCESS) {
+        bufPalette = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            palette.size(), palette.data(), &err);
+    }
+    if (!bufGrid || !bufImage || !bufPalette || err != CL_SUCCESS) {
         std::cerr << "Failed to create CPU buffers\n";
         return false;
     }
@@ -88,11 +83,28 @@ bool CLColorizer::init(uint32_t w, uint32_t h, const char* src)
     return true;
 }
 
+// Used when no OpenCL CPU device is available.
+static void colorize_host(const std::vector<unsigned char>& species,
+    const std::vector<unsigned char>& palette,
+    std::vector<unsigned char>& rgba, uint32_t n)
+{
+    rgba.resize(static_cast<size_t>(n) * 4);
+    for (uint32_t i = 0; i < n; ++i) {
+        std::memcpy(rgba.data() + static_cast<size_t>(i) * 4,
+            palette.data() + static_cast<size_t>(species[i]) * 4, 4);
+    }
+}
+
 void CLColorizer::colorize(const std::vector<unsigned char>& species,
     std::vector<unsigned char>& rgba)
 {
     if (species.size() < N) return;
 
+    if (!kernel || !bufGrid || !bufImage || !bufPalette) {
+        colorize_host(species, palette, rgba, N);
+        return;
+    }
+
     cl_int err = CL_SUCCESS;
 
     err = clEnqueueWriteBuffer(queue, bufGrid, CL_TRUE,
@@ -105,7 +117,8 @@ void CLColorizer::colorize(const std::vector<unsigned char>& species,
 
     err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufGrid);
     err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufImage);
-    err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &N);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufPalette);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &N);
     if (err != CL_SUCCESS) {
         std::cerr << "CPU colorizer: set args failed\n";
         return;
@@ -135,6 +148,7 @@ void CLColorizer::colorize(const std::vector<unsigned char>& species,
 
 void CLColorizer::shutdown()
 {
+    if (bufPalette) clReleaseMemObject(bufPalette);
     if (bufImage) clReleaseMemObject(bufImage);
     if (bufGrid)  clReleaseMemObject(bufGrid);
     if (kernel)   clReleaseKernel(kernel);
@@ -142,7 +156,7 @@ void CLColorizer::shutdown()
     if (queue)    clReleaseCommandQueue(queue);
     if (context)  clReleaseContext(context);
 
-    bufImage = bufGrid = nullptr;
+    bufPalette = bufImage = bufGrid = nullptr;
     kernel = nullptr;
     program = nullptr;
     queue = nullptr;
@@ -12,9 +12,11 @@ struct CLColorizer {
     cl_kernel        kernel = nullptr;
     cl_mem           bufGrid = nullptr;
     cl_mem           bufImage = nullptr;
+    cl_mem           bufPalette = nullptr;
     uint32_t         N = 0;
+    std::vector<unsigned char> palette;   // species_palette(), RGBA x 256
 
-    bool init(uint32_t w, uint32_t h, const char* src);
+    bool init(uint32_t w, uint32_t h, uint32_t numSpecies, const char* src);
     void colorize(const std::vector<unsigned char>& species,
         std::vector<unsigned char>& rgba);
     void shutdown();
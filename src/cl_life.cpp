@@ -1,9 +1,27 @@
 #include "cl_life.h"
 #include "kernel_source.h"
+#include "palette.h"
+#include "program_cache.h"
 
 #include <vector>
 #include <iostream>
-#include <cstring>
+#include <algorithm>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static int ctz32(uint32_t v)
+{
+    unsigned long i = 0;
+    _BitScanForward(&i, v);
+    return static_cast<int>(i);
+}
+#else
+static int ctz32(uint32_t v)
+{
+    return __builtin_ctz(v);
+}
+#endif
 
 #define CHECK_CL(err, msg) \
     if ((err) != CL_SUCCESS) { \
@@ -11,16 +29,190 @@
         return false; \
     }
 
+// Local memory the kernel declares itself (the stats histogram), which the
+// tiles have to leave room for.
+static cl_ulong kernel_local_mem(cl_device_id device, cl_kernel k)
+{
+    cl_ulong bytes = 0;
+    clGetKernelWorkGroupInfo(k, device, CL_KERNEL_LOCAL_MEM_SIZE,
+        sizeof(bytes), &bytes, nullptr);
+    return bytes;
+}
+
+static void choose_tile(cl_device_id device, cl_kernel k,
+    size_t& tw, size_t& th)
+{
+    size_t maxWG = 0, pref = 0;
+    cl_ulong localMem = 0;
+    clGetKernelWorkGroupInfo(k, device, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(maxWG), &maxWG, nullptr);
+    clGetKernelWorkGroupInfo(k, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+        sizeof(pref), &pref, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE,
+        sizeof(localMem), &localMem, nullptr);
+
+    if (maxWG == 0) maxWG = 64;
+    if (localMem == 0) localMem = 16 * 1024;
+    localMem -= std::min(localMem / 2, kernel_local_mem(device, k));
+    const size_t cap = std::min<size_t>(maxWG, 256);
+
+    tw = std::max<size_t>(pref, 16);
+    while (tw > cap) tw /= 2;
+
+    th = 1;
+    while (tw * th * 2 <= cap && (tw + 2) * (th * 2 + 2) <= localMem)
+        th *= 2;
+}
+
+static void pack_planes(const std::vector<unsigned char>& host,
+    uint32_t w, uint32_t h, uint32_t ww, uint32_t numSpecies,
+    std::vector<cl_uint>& bits)
+{
+    const size_t plane = static_cast<size_t>(ww) * h;
+    bits.assign(plane * numSpecies, 0u);
+    for (uint32_t y = 0; y < h; ++y) {
+        const unsigned char* row = host.data() + static_cast<size_t>(y) * w;
+        for (uint32_t x = 0; x < w; ++x) {
+            uint32_t v = row[x];
+            if (v == 0 || v > numSpecies) continue;
+            bits[(v - 1) * plane + static_cast<size_t>(y) * ww + (x >> 5)] |= 1u << (x & 31u);
+        }
+    }
+}
+
+static void unpack_planes(const std::vector<cl_uint>& bits,
+    uint32_t w, uint32_t h, uint32_t ww, uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    const size_t plane = static_cast<size_t>(ww) * h;
+    std::fill(host.begin(), host.begin() + static_cast<size_t>(w) * h, 0);
+
+    for (uint32_t p = numSpecies; p-- > 0;) {
+        for (uint32_t y = 0; y < h; ++y) {
+            unsigned char* row = host.data() + static_cast<size_t>(y) * w;
+            const cl_uint* in = bits.data() + p * plane + static_cast<size_t>(y) * ww;
+            for (uint32_t xw = 0; xw < ww; ++xw) {
+                cl_uint word = in[xw];
+                while (word) {
+                    uint32_t x = (xw << 5) + static_cast<uint32_t>(ctz32(word));
+                    row[x] = static_cast<unsigned char>(p + 1);
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+}
+
+// Host side of HASH_MIX/HASH_A/HASH_B in kernel_source.h, used to hash the
+// seed; the kernels then only report how each launch changes the lanes.
+static uint32_t hash_mix(uint32_t x)
+{
+    x ^= x >> 16; x *= 0x7FEB352Du;
+    x ^= x >> 15; x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void grid_hash(const uint32_t* v, size_t n, uint32_t lanes[2])
+{
+    lanes[0] = lanes[1] = 0;
+    for (size_t id = 0; id < n; ++id) {
+        if (!v[id]) continue;
+        const uint32_t i = static_cast<uint32_t>(id);
+        lanes[0] += hash_mix(i * 0x9E3779B1u + v[id] * 0x85EBCA77u);
+        lanes[1] += hash_mix(i * 0xC2B2AE35u + v[id] * 0x27D4EB2Fu + 0x165667B1u);
+    }
+}
+
+static void grid_hash(const unsigned char* cells, size_t n, uint32_t lanes[2])
+{
+    std::vector<uint32_t> v(cells, cells + n);
+    grid_hash(v.data(), n, lanes);
+}
+
+static void choose_temporal_tile(cl_device_id device, cl_kernel k, uint32_t K,
+    size_t& group, uint32_t& tw, uint32_t& th)
+{
+    size_t maxWG = 0;
+    cl_ulong localMem = 0;
+    clGetKernelWorkGroupInfo(k, device, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(maxWG), &maxWG, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE,
+        sizeof(localMem), &localMem, nullptr);
+
+    if (maxWG == 0) maxWG = 64;
+    if (localMem == 0) localMem = 16 * 1024;
+    localMem -= std::min(localMem / 2, kernel_local_mem(device, k));
+    group = std::min<size_t>(maxWG, 256);
+
+    tw = 64;
+    th = 32;
+    while (2ull * (tw + 2 * K) * (th + 2 * K) > localMem && th > 8) th /= 2;
+    while (2ull * (tw + 2 * K) * (th + 2 * K) > localMem && tw > 8) tw /= 2;
+}
+
+// Kernel time of one step; with active tiles it spans the compaction pass too.
+static double step_ms(cl_event evtKernel, cl_event evtCompact)
+{
+    clWaitForEvents(1, &evtKernel);
+    cl_ulong t0 = 0, t1 = 0;
+    clGetEventProfilingInfo(evtKernel, CL_PROFILING_COMMAND_START,
+        sizeof(t0), &t0, nullptr);
+    clGetEventProfilingInfo(evtKernel, CL_PROFILING_COMMAND_END,
+        sizeof(t1), &t1, nullptr);
+    if (evtCompact) {
+        clGetEventProfilingInfo(evtCompact, CL_PROFILING_COMMAND_START,
+            sizeof(t0), &t0, nullptr);
+    }
+    return static_cast<double>(t1 - t0) * 1e-6;
+}
+
+static const char* step_kernel_name(LifeMode mode)
+{
+    switch (mode) {
+    case LifeMode::Tiled:       return "life_step_tiled";
+    case LifeMode::BitPlanes:   return "life_step_bits";
+    case LifeMode::Temporal:    return "life_step_temporal";
+    case LifeMode::ActiveTiles: return "life_step_active";
+    default:                    return "life_step";
+    }
+}
+
+static bool is_pow2(uint32_t v)
+{
+    return v && !(v & (v - 1));
+}
+
+bool CLLife::set_rule(const char* rule)
+{
+    uint32_t b = 0, s = 0;
+    uint32_t* cur = nullptr;
+    for (const char* p = rule; *p; ++p) {
+        if (*p == 'B' || *p == 'b') cur = &b;
+        else if (*p == 'S' || *p == 's') cur = &s;
+        else if (*p >= '0' && *p <= '8' && cur) {
+            // A birth needs a species among the neighbours, so B0 could
+            // never fire.
+            if (cur == &b && *p == '0') return false;
+            *cur |= 1u << (*p - '0');
+        }
+        else if (*p != '/') return false;
+    }
+    if (!b) return false;
+
+    birthMask = b;
+    surviveMask = s;
+    return true;
+}
+
 bool CLLife::init(uint32_t w, uint32_t h,
     uint32_t numSpecies,
     const char* src)
 {
-    (void)numSpecies;
-
     cl_int err = CL_SUCCESS;
 
     cl_platform_id platform = nullptr;
-    cl_device_id   device = nullptr;
+    device = nullptr;
 
     cl_uint numPlatforms = 0;
     err = clGetPlatformIDs(0, nullptr, &numPlatforms);
@@ -59,8 +251,36 @@ bool CLLife::init(uint32_t w, uint32_t h,
         computeUnits = cu;
     }
 
-    context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
-    CHECK_CL(err, "clCreateContext failed");
+    glShared = false;
+    if (!glShareProps.empty()) {
+        size_t extSize = 0;
+        clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, nullptr, &extSize);
+        std::string ext(extSize, '\0');
+        clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extSize, &ext[0], nullptr);
+
+        if (ext.find("cl_khr_gl_sharing") != std::string::npos) {
+            std::vector<cl_context_properties> props = glShareProps;
+            props.push_back(CL_CONTEXT_PLATFORM);
+            props.push_back(reinterpret_cast<cl_context_properties>(platform));
+            props.push_back(0);
+
+            context = clCreateContext(props.data(), 1, &device, nullptr, nullptr, &err);
+            glShared = (err == CL_SUCCESS);
+            if (!glShared) {
+                std::cerr << "Warning: CL/GL shared context failed (err="
+                    << err << "), colorizing through the host\n";
+                context = nullptr;
+            }
+        }
+        else {
+            std::cerr << "Warning: cl_khr_gl_sharing not supported, colorizing through the host\n";
+        }
+    }
+
+    if (!context) {
+        context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+        CHECK_CL(err, "clCreateContext failed");
+    }
 
     const cl_queue_properties qprops[] = {
         CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0
@@ -68,8 +288,143 @@ bool CLLife::init(uint32_t w, uint32_t h,
     queue = clCreateCommandQueueWithProperties(context, device, qprops, &err);
     CHECK_CL(err, "clCreateCommandQueueWithProperties failed");
 
+    if (framesInFlight > 1) {
+        xferQueue = clCreateCommandQueueWithProperties(context, device, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            std::cerr << "Warning: no transfer queue (err=" << err
+                << "), reading back synchronously\n";
+            xferQueue = nullptr;
+            framesInFlight = 1;
+        }
+    }
+
+    if (deviceEnqueue) {
+        cl_command_queue_properties onDevice = 0;
+        cl_uint preferred = 0;
+        clGetDeviceInfo(device, CL_DEVICE_QUEUE_ON_DEVICE_PROPERTIES,
+            sizeof(onDevice), &onDevice, nullptr);
+        clGetDeviceInfo(device, CL_DEVICE_QUEUE_ON_DEVICE_PREFERRED_SIZE,
+            sizeof(preferred), &preferred, nullptr);
+        if (onDevice) {
+            std::vector<cl_queue_properties> dprops = {
+                CL_QUEUE_PROPERTIES, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE
+                    | CL_QUEUE_ON_DEVICE | CL_QUEUE_ON_DEVICE_DEFAULT
+            };
+            if (preferred) {
+                dprops.push_back(CL_QUEUE_SIZE);
+                dprops.push_back(preferred);
+            }
+            dprops.push_back(0);
+            deviceQueue = clCreateCommandQueueWithProperties(context, device, dprops.data(), &err);
+            if (err != CL_SUCCESS) deviceQueue = nullptr;
+        }
+        if (!deviceQueue) {
+            std::cerr << "Warning: no on-device queue, autonomous runs use the host queue\n";
+        }
+    }
+
+    source = src;
+    workItems = 0;
+    localSize = 64;
+    lastKernelMs = 0.0;
+    lastLiveCells = 0;
+    statsReads.assign(STATS_RING, StatsRead());
+
+    return configure(w, h, numSpecies);
+}
+
+std::string CLLife::build_options(uint32_t w, uint32_t h,
+    uint32_t numSpecies, bool specialized) const
+{
+    std::string opts = "-cl-std=CL2.0";
+    if (specialized) {
+        opts += " -DLIFE_W=" + std::to_string(w) + "u";
+        opts += " -DLIFE_H=" + std::to_string(h) + "u";
+        opts += " -DLIFE_NS=" + std::to_string(numSpecies) + "u";
+    }
+    opts += wrap ? " -DLIFE_WRAP=1" : " -DLIFE_WRAP=0";
+    opts += " -DLIFE_BIRTH=" + std::to_string(birthMask) + "u";
+    opts += " -DLIFE_SURVIVE=" + std::to_string(surviveMask) + "u";
+    if (deviceQueue) opts += " -DDEVICE_ENQUEUE";
+    return opts;
+}
+
+cl_program CLLife::get_program(const std::string& opts)
+{
+    auto it = programs.find(opts);
+    if (it != programs.end()) return it->second;
+
+    std::string log;
+    cl_program prog = build_program(context, device, source, opts.c_str(), log);
+    if (!prog) {
+        std::cerr << "CL build error (" << opts << "):\n" << log << "\n";
+        return nullptr;
+    }
+
+    programs[opts] = prog;
+    return prog;
+}
+
+void CLLife::release_grid()
+{
+    if (tilesCount)   clReleaseMemObject(tilesCount);
+    if (tilesList)    clReleaseMemObject(tilesList);
+    if (tilesNext)    clReleaseMemObject(tilesNext);
+    if (tilesChanged) clReleaseMemObject(tilesChanged);
+    if (tilesCompact) clReleaseKernel(tilesCompact);
+    if (colorizeK)    clReleaseKernel(colorizeK);
+    if (paletteBuf)   clReleaseMemObject(paletteBuf);
+    if (kBA)          clReleaseKernel(kBA);
+    if (kAB)          clReleaseKernel(kAB);
+    if (bufB)         clReleaseMemObject(bufB);
+    if (bufA)         clReleaseMemObject(bufA);
+    if (statsBuf[1])  clReleaseMemObject(statsBuf[1]);
+    if (statsBuf[0])  clReleaseMemObject(statsBuf[0]);
+    if (ctlBuf)       clReleaseMemObject(ctlBuf);
+    if (scheduleK)    clReleaseKernel(scheduleK);
+
+    tilesCount = nullptr;
+    tilesList = nullptr;
+    tilesNext = nullptr;
+    tilesChanged = nullptr;
+    tilesCompact = nullptr;
+    colorizeK = nullptr;
+    paletteBuf = nullptr;
+    kBA = nullptr;
+    kAB = nullptr;
+    bufB = nullptr;
+    bufA = nullptr;
+    statsBuf[1] = nullptr;
+    statsBuf[0] = nullptr;
+    ctlBuf = nullptr;
+    scheduleK = nullptr;
+}
+
+bool CLLife::configure(uint32_t w, uint32_t h, uint32_t numSpecies)
+{
+    drain_pipeline();
+    release_grid();
+
+    if (numSpecies == 1) {
+        mode = LifeMode::BitPlanes;
+    }
+    if (mode == LifeMode::BitPlanes
+        && (wrap || birthMask != (1u << 3) || surviveMask != ((1u << 2) | (1u << 3)))) {
+        std::cerr << "Warning: bit-plane kernel only supports B3/S23 with a dead "
+            "boundary, using tiled kernel\n";
+        mode = LifeMode::Tiled;
+    }
+
+    program = get_program(build_options(w, h, numSpecies, specialize));
+    if (!program) return false;
+
+    cl_int err = CL_SUCCESS;
+
     const size_t N = static_cast<size_t>(w) * static_cast<size_t>(h);
-    const size_t bytes = N * sizeof(cl_uchar);
+    wordsPerRow = (w + 31) / 32;
+    const size_t bytes = (mode == LifeMode::BitPlanes)
+        ? static_cast<size_t>(wordsPerRow) * h * numSpecies * sizeof(cl_uint)
+        : N * sizeof(cl_uchar);
 
     bufA = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
     CHECK_CL(err, "Failed to create bufA");
@@ -77,85 +432,379 @@ bool CLLife::init(uint32_t w, uint32_t h,
     bufB = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
     CHECK_CL(err, "Failed to create bufB");
 
-    const char* srcs[] = { src };
-    size_t      lens[] = { std::strlen(src) };
+    for (cl_mem& b : statsBuf) {
+        b = clCreateBuffer(context, CL_MEM_READ_WRITE, STATS_INTS * sizeof(cl_int), nullptr, &err);
+        if (err != CL_SUCCESS) {
+            std::cerr << "Warning: no species statistics (err=" << err << ")\n";
+            b = nullptr;
+        }
+    }
 
-    program = clCreateProgramWithSource(context, 1, srcs, lens, &err);
-    CHECK_CL(err, "clCreateProgramWithSource failed");
+    if (!create_step_kernels()) return false;
+    if (mode == LifeMode::ActiveTiles && !create_tile_tracking(w, h)) return false;
 
-    const char* buildOpts = "-cl-std=CL2.0";
-    err = clBuildProgram(program, 1, &device, buildOpts, nullptr, nullptr);
-    if (err != CL_SUCCESS) {
-        size_t logSize = 0;
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG,
-            0, nullptr, &logSize);
-        std::vector<char> log(logSize);
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG,
-            logSize, log.data(), nullptr);
-        std::cerr << "CL build error:\n" << log.data() << "\n";
-        return false;
+    // The scheduler steps the byte grid with life_step, so bit planes
+    // always run autonomously on the host queue.
+    if (deviceQueue && mode != LifeMode::BitPlanes) {
+        scheduleK = clCreateKernel(program, "life_schedule", &err);
+        if (err == CL_SUCCESS) {
+            ctlBuf = clCreateBuffer(context, CL_MEM_READ_WRITE,
+                (CTL_POP + 1 + numSpecies) * sizeof(cl_long), nullptr, &err);
+        }
+        if (err != CL_SUCCESS) {
+            std::cerr << "Warning: device-side scheduler not available (err="
+                << err << ")\n";
+            if (scheduleK) clReleaseKernel(scheduleK);
+            scheduleK = nullptr;
+        }
+    }
+
+    cl_int err2 = CL_SUCCESS;
+
+    if (glShared) {
+        colorizeK = clCreateKernel(program,
+            mode == LifeMode::BitPlanes ? "colorize_planes" : "colorize_image", &err2);
+        if (err2 == CL_SUCCESS) {
+            std::vector<unsigned char> rgba;
+            species_palette(numSpecies, rgba);
+            paletteBuf = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                rgba.size(), rgba.data(), &err2);
+        }
+        if (err2 != CL_SUCCESS) {
+            std::cerr << "Warning: colorize kernel not available (err="
+                << err2 << ")\n";
+            if (colorizeK) clReleaseKernel(colorizeK);
+            colorizeK = nullptr;
+        }
     }
 
+    gridW = w;
+    gridH = h;
+    gridNS = numSpecies;
+    seeded = false;
+    hostDirty = false;
+    flip = false;
+    generation = 0;
+    activeTiles = 0;
+    lastActiveFraction = 1.0;
+    lastLiveCells = 0;
+    lastBirths = lastDeaths = 0;
+    speciesPop.assign(numSpecies + 1, 0);
+    statsParity = 0;
+    hashLanes[0] = hashLanes[1] = 0;
+    hashRing.assign(cycleWindow, { UINT64_MAX, 0 });
+    hashRingHead = 0;
+    cyclePeriod = 0;
+    cycleGeneration = 0;
+
+    return true;
+}
 
-    kAB = clCreateKernel(program, "life_step", &err);
+bool CLLife::create_step_kernels()
+{
+    if (kBA) clReleaseKernel(kBA);
+    if (kAB) clReleaseKernel(kAB);
+    kAB = kBA = nullptr;
+
+    const char* stepName = step_kernel_name(mode);
+
+    cl_int err = CL_SUCCESS;
+    kAB = clCreateKernel(program, stepName, &err);
     CHECK_CL(err, "Failed to create kernel kAB");
 
-    kBA = clCreateKernel(program, "life_step", &err);
+    kBA = clCreateKernel(program, stepName, &err);
     CHECK_CL(err, "Failed to create kernel kBA");
 
-    cl_int err2 = CL_SUCCESS;
+    // No statistics until step() binds a stats buffer, so validation and
+    // benchmark launches are not counted.
+    clSetKernelArg(kAB, 5, sizeof(cl_mem), nullptr);
+    clSetKernelArg(kBA, 5, sizeof(cl_mem), nullptr);
 
-    pipeProducer = clCreateKernel(program, "pipe_producer", &err2);
-    if (!pipeProducer || err2 != CL_SUCCESS) {
-        std::cerr << "Warning: pipe_producer kernel not available (err="
-            << err2 << ")\n";
-        pipeProducer = nullptr;
+    if (mode == LifeMode::Tiled || mode == LifeMode::ActiveTiles) {
+        choose_tile(device, kAB, tileW, tileH);
     }
-
-    pipeConsumer = clCreateKernel(program, "pipe_consumer", &err2);
-    if (!pipeConsumer || err2 != CL_SUCCESS) {
-        std::cerr << "Warning: pipe_consumer kernel not available (err="
-            << err2 << ")\n";
-        pipeConsumer = nullptr;
+    if (mode == LifeMode::Temporal) {
+        choose_temporal_tile(device, kAB, temporalSteps,
+            temporalGroup, temporalTileW, temporalTileH);
     }
+    return true;
+}
 
-    if (pipeProducer && pipeConsumer) {
-        cl_uint pipeCapacity = static_cast<cl_uint>(pipeWorkItems);
+bool CLLife::create_tile_tracking(uint32_t w, uint32_t h)
+{
+    cl_int err = CL_SUCCESS;
 
-        statsPipe = clCreatePipe(context,
-            CL_MEM_READ_WRITE,
-            sizeof(cl_uint),
-            pipeCapacity,
-            nullptr,
-            &err2);
-        if (!statsPipe || err2 != CL_SUCCESS) {
-            std::cerr << "Warning: failed to create statsPipe (err="
-                << err2 << ")\n";
-            statsPipe = nullptr;
-        }
+    tilesX = static_cast<cl_uint>((w + tileW - 1) / tileW);
+    tilesY = static_cast<cl_uint>((h + tileH - 1) / tileH);
+    const size_t bytes = static_cast<size_t>(tilesX) * tilesY * sizeof(cl_uint);
 
-        statsBuffer = clCreateBuffer(context,
-            CL_MEM_WRITE_ONLY,
-            pipeCapacity * sizeof(cl_uint),
-            nullptr,
-            &err2);
-        if (!statsBuffer || err2 != CL_SUCCESS) {
-            std::cerr << "Warning: failed to create statsBuffer (err="
-                << err2 << ")\n";
-            statsBuffer = nullptr;
+    tilesCompact = clCreateKernel(program, "tiles_compact", &err);
+    CHECK_CL(err, "Failed to create kernel tiles_compact");
+
+    tilesChanged = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    CHECK_CL(err, "Failed to create tilesChanged");
+    tilesNext = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    CHECK_CL(err, "Failed to create tilesNext");
+    tilesList = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    CHECK_CL(err, "Failed to create tilesList");
+    tilesCount = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint), nullptr, &err);
+    CHECK_CL(err, "Failed to create tilesCount");
+
+    const cl_uint one = 1;
+    err = clEnqueueFillBuffer(queue, tilesChanged, &one, sizeof(one),
+        0, bytes, 0, nullptr, nullptr);
+    CHECK_CL(err, "Failed to mark all tiles active");
+
+    return true;
+}
+
+static cl_int set_temporal_args(cl_kernel k,
+    cl_mem src, cl_mem dst, uint32_t W, uint32_t H, uint32_t S,
+    uint32_t K, uint32_t TW, uint32_t TH)
+{
+    const size_t tileBytes = (TW + 2 * K) * (TH + 2 * K) * sizeof(cl_uchar);
+
+    cl_int err = clSetKernelArg(k, 0, sizeof(cl_mem), &src);
+    err |= clSetKernelArg(k, 1, sizeof(cl_mem), &dst);
+    err |= clSetKernelArg(k, 2, sizeof(cl_uint), &W);
+    err |= clSetKernelArg(k, 3, sizeof(cl_uint), &H);
+    err |= clSetKernelArg(k, 4, sizeof(cl_uint), &S);
+    err |= clSetKernelArg(k, 6, sizeof(cl_uint), &K);
+    err |= clSetKernelArg(k, 7, sizeof(cl_uint), &TW);
+    err |= clSetKernelArg(k, 8, sizeof(cl_uint), &TH);
+    err |= clSetKernelArg(k, 9, tileBytes, nullptr);
+    err |= clSetKernelArg(k, 10, tileBytes, nullptr);
+    return err;
+}
+
+static cl_int launch_temporal(cl_command_queue q, cl_kernel k,
+    uint32_t W, uint32_t H, size_t group, uint32_t TW, uint32_t TH, cl_event* evt)
+{
+    size_t global2[2] = { (W + TW - 1) / TW * group, (H + TH - 1) / TH };
+    size_t local2[2] = { group, 1 };
+
+    return clEnqueueNDRangeKernel(q, k, 2, nullptr,
+        global2, local2, 0, nullptr, evt);
+}
+
+static cl_int enqueue_temporal(cl_command_queue q, cl_kernel k,
+    cl_mem src, cl_mem dst, uint32_t W, uint32_t H, uint32_t S,
+    uint32_t K, size_t group, uint32_t TW, uint32_t TH, cl_event* evt)
+{
+    cl_int err = set_temporal_args(k, src, dst, W, H, S, K, TW, TH);
+    if (err != CL_SUCCESS) return err;
+    return launch_temporal(q, k, W, H, group, TW, TH, evt);
+}
+
+bool CLLife::validate_temporal(uint32_t w, uint32_t h, uint32_t numSpecies)
+{
+    const size_t bytes = static_cast<size_t>(w) * h * sizeof(cl_uchar);
+    cl_int err = CL_SUCCESS;
+
+    cl_kernel ref = clCreateKernel(program, "life_step", &err);
+    cl_mem c0 = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    cl_mem c1 = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+
+    bool ok = ref && c0 && c1;
+    if (ok) {
+        clEnqueueCopyBuffer(queue, bufA, c0, 0, 0, bytes, 0, nullptr, nullptr);
+
+        size_t global = static_cast<size_t>(w) * h;
+        for (uint32_t g = 0; g < temporalSteps; ++g) {
+            cl_mem in = (g & 1) ? c1 : c0;
+            cl_mem out = (g & 1) ? c0 : c1;
+            clSetKernelArg(ref, 0, sizeof(cl_mem), &in);
+            clSetKernelArg(ref, 1, sizeof(cl_mem), &out);
+            clSetKernelArg(ref, 2, sizeof(cl_uint), &w);
+            clSetKernelArg(ref, 3, sizeof(cl_uint), &h);
+            clSetKernelArg(ref, 4, sizeof(cl_uint), &numSpecies);
+            clSetKernelArg(ref, 5, sizeof(cl_mem), nullptr);
+            clEnqueueNDRangeKernel(queue, ref, 1, nullptr,
+                &global, nullptr, 0, nullptr, nullptr);
         }
+
+        err = enqueue_temporal(queue, kAB, bufA, bufB, w, h, numSpecies,
+            temporalSteps, temporalGroup, temporalTileW, temporalTileH, nullptr);
+
+        std::vector<unsigned char> expect(bytes), got(bytes);
+        cl_mem refOut = (temporalSteps & 1) ? c1 : c0;
+        clEnqueueReadBuffer(queue, refOut, CL_TRUE, 0, bytes,
+            expect.data(), 0, nullptr, nullptr);
+        clEnqueueReadBuffer(queue, bufB, CL_TRUE, 0, bytes,
+            got.data(), 0, nullptr, nullptr);
+
+        ok = (err == CL_SUCCESS) && expect == got;
     }
 
-    flip = false;
-    workItems = 0;
-    localSize = 64;
-    lastKernelMs = 0.0;
-    lastLiveCells = 0;
+    if (c1)  clReleaseMemObject(c1);
+    if (c0)  clReleaseMemObject(c0);
+    if (ref) clReleaseKernel(ref);
+    return ok;
+}
 
-    return true;
+cl_int CLLife::set_step_args(cl_kernel k, cl_mem src, cl_mem dst,
+    uint32_t W, uint32_t H, uint32_t S)
+{
+    if (mode == LifeMode::Temporal) {
+        return set_temporal_args(k, src, dst, W, H, S,
+            temporalSteps, temporalTileW, temporalTileH);
+    }
+
+    cl_int err = clSetKernelArg(k, 0, sizeof(cl_mem), &src);
+    err |= clSetKernelArg(k, 1, sizeof(cl_mem), &dst);
+    err |= clSetKernelArg(k, 2, sizeof(cl_uint), &W);
+    err |= clSetKernelArg(k, 3, sizeof(cl_uint), &H);
+    err |= clSetKernelArg(k, 4, sizeof(cl_uint), &S);
+    if (mode == LifeMode::Tiled) {
+        err |= clSetKernelArg(k, 6, (tileW + 2) * (tileH + 2) * sizeof(cl_uchar), nullptr);
+    }
+    return err;
 }
 
-void CLLife::step(uint32_t w, uint32_t h,
+cl_int CLLife::launch_step(cl_kernel k, uint32_t W, uint32_t H, cl_event* evt)
+{
+    if (mode == LifeMode::Temporal) {
+        return launch_temporal(queue, k, W, H,
+            temporalGroup, temporalTileW, temporalTileH, evt);
+    }
+    if (mode == LifeMode::Tiled) {
+        size_t global2[2] = {
+            (W + tileW - 1) / tileW * tileW,
+            (H + tileH - 1) / tileH * tileH
+        };
+        size_t local2[2] = { tileW, tileH };
+
+        return clEnqueueNDRangeKernel(queue, k, 2, nullptr,
+            global2, local2,
+            0, nullptr, evt);
+    }
+    if (mode == LifeMode::BitPlanes) {
+        size_t global2[2] = { wordsPerRow, H };
+
+        return clEnqueueNDRangeKernel(queue, k, 2, nullptr,
+            global2, nullptr,
+            0, nullptr, evt);
+    }
+
+    size_t global = workItems ? workItems : static_cast<size_t>(W) * H;
+    return clEnqueueNDRangeKernel(queue, k, 1, nullptr,
+        &global, (localSize ? &localSize : nullptr),
+        0, nullptr, evt);
+}
+
+cl_int CLLife::enqueue_step(cl_kernel k, cl_mem src, cl_mem dst,
+    uint32_t W, uint32_t H, uint32_t S, cl_event* evt)
+{
+    cl_int err = set_step_args(k, src, dst, W, H, S);
+    if (err != CL_SUCCESS) return err;
+    return launch_step(k, W, H, evt);
+}
+
+// The active-tile kernels take their tile lists as arguments and the lists
+// swap every launch, so unlike the other modes nothing stays bound.
+void CLLife::enqueue_active(cl_kernel k, cl_mem src, cl_mem dst,
+    uint32_t W, uint32_t H, uint32_t S, cl_event* evtCompact, cl_event* evtKernel)
+{
+    const cl_uint zero = 0;
+    const size_t numTiles = static_cast<size_t>(tilesX) * tilesY;
+
+    clEnqueueFillBuffer(queue, tilesCount, &zero, sizeof(zero),
+        0, sizeof(zero), 0, nullptr, nullptr);
+
+    clSetKernelArg(tilesCompact, 0, sizeof(cl_mem), &tilesChanged);
+    clSetKernelArg(tilesCompact, 1, sizeof(cl_mem), &tilesNext);
+    clSetKernelArg(tilesCompact, 2, sizeof(cl_mem), &tilesList);
+    clSetKernelArg(tilesCompact, 3, sizeof(cl_mem), &tilesCount);
+    clSetKernelArg(tilesCompact, 4, sizeof(cl_uint), &tilesX);
+    clSetKernelArg(tilesCompact, 5, sizeof(cl_uint), &tilesY);
+    clEnqueueNDRangeKernel(queue, tilesCompact, 1, nullptr,
+        &numTiles, nullptr, 0, nullptr, evtCompact);
+
+    clSetKernelArg(k, 0, sizeof(cl_mem), &src);
+    clSetKernelArg(k, 1, sizeof(cl_mem), &dst);
+    clSetKernelArg(k, 2, sizeof(cl_uint), &W);
+    clSetKernelArg(k, 3, sizeof(cl_uint), &H);
+    clSetKernelArg(k, 4, sizeof(cl_uint), &S);
+    clSetKernelArg(k, 6, (tileW + 2) * (tileH + 2) * sizeof(cl_uchar), nullptr);
+    clSetKernelArg(k, 7, sizeof(cl_mem), &tilesList);
+    clSetKernelArg(k, 8, sizeof(cl_mem), &tilesCount);
+    clSetKernelArg(k, 9, sizeof(cl_mem), &tilesNext);
+    clSetKernelArg(k, 10, sizeof(cl_uint), &tilesX);
+
+    size_t global2[2] = { tileW * numTiles, tileH };
+    size_t local2[2] = { tileW, tileH };
+
+    clEnqueueNDRangeKernel(queue, k, 2, nullptr,
+        global2, local2,
+        0, nullptr, evtKernel);
+
+    std::swap(tilesChanged, tilesNext);
+}
+
+static double time_launches(cl_command_queue q, CLLife& life, cl_kernel k,
+    uint32_t w, uint32_t h, uint32_t numSpecies, int runs)
+{
+    cl_ulong total = 0;
+    for (int i = 0; i < runs; ++i) {
+        cl_event evt = nullptr;
+        cl_mem src = (i & 1) ? life.bufB : life.bufA;
+        cl_mem dst = (i & 1) ? life.bufA : life.bufB;
+        if (life.enqueue_step(k, src, dst, w, h, numSpecies, &evt) != CL_SUCCESS)
+            return 0.0;
+        clWaitForEvents(1, &evt);
+        cl_ulong t0 = 0, t1 = 0;
+        clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_START,
+            sizeof(t0), &t0, nullptr);
+        clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_END,
+            sizeof(t1), &t1, nullptr);
+        clReleaseEvent(evt);
+        total += t1 - t0;
+    }
+    clFinish(q);
+    return static_cast<double>(total) * 1e-6 / runs;
+}
+
+void CLLife::benchmark_specialization(uint32_t w, uint32_t h, uint32_t numSpecies)
+{
+    // The seeded grid is saved and restored around the timing runs.
+    if (mode == LifeMode::ActiveTiles) return;
+    cl_program generic = get_program(build_options(w, h, numSpecies, false));
+    if (!generic) return;
+
+    cl_int err = CL_SUCCESS;
+    cl_kernel kGeneric = clCreateKernel(generic, step_kernel_name(mode), &err);
+    if (err != CL_SUCCESS) return;
+    clSetKernelArg(kGeneric, 5, sizeof(cl_mem), nullptr);
+
+    size_t bytes = 0;
+    clGetMemObjectInfo(bufA, CL_MEM_SIZE, sizeof(bytes), &bytes, nullptr);
+    cl_mem keepA = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    if (err == CL_SUCCESS) {
+        clEnqueueCopyBuffer(queue, bufA, keepA, 0, 0, bytes, 0, nullptr, nullptr);
+
+        const int runs = 20;
+        time_launches(queue, *this, kAB, w, h, numSpecies, 2);
+        specializedKernelMs = time_launches(queue, *this, kAB, w, h, numSpecies, runs);
+        time_launches(queue, *this, kGeneric, w, h, numSpecies, 2);
+        genericKernelMs = time_launches(queue, *this, kGeneric, w, h, numSpecies, runs);
+
+        clEnqueueCopyBuffer(queue, keepA, bufA, 0, 0, bytes, 0, nullptr, nullptr);
+        clFinish(queue);
+        clReleaseMemObject(keepA);
+
+        if (specializedKernelMs > 0.0) {
+            std::cout << "Specialized " << step_kernel_name(mode)
+                << " (" << w << "x" << h << ", " << numSpecies << " species): "
+                << specializedKernelMs << " ms vs generic "
+                << genericKernelMs << " ms ("
+                << genericKernelMs / specializedKernelMs << "x)\n";
+        }
+    }
+    clReleaseKernel(kGeneric);
+}
+
+// Rebuilds for a new grid size and uploads the seed on the first step.
+bool CLLife::prepare(uint32_t w, uint32_t h,
     uint32_t numSpecies,
     std::vector<unsigned char>& host)
 {
@@ -164,11 +813,26 @@ void CLLife::step(uint32_t w, uint32_t h,
     const uint32_t H = h;
     const uint32_t N = W * H;
 
-    size_t global = workItems ? workItems : static_cast<size_t>(N);
+    if (W != gridW || H != gridH || S != gridNS) {
+        if (!configure(W, H, S)) {
+            std::cerr << "Failed to rebuild kernels for " << W << "x" << H << "\n";
+            return false;
+        }
+    }
 
-    static bool seeded = false;
     if (!seeded) {
-        if (host.size() >= N) {
+        if (host.size() >= N && mode == LifeMode::BitPlanes) {
+            pack_planes(host, W, H, wordsPerRow, S, hostBits);
+            cl_int errSeed = clEnqueueWriteBuffer(
+                queue, bufA, CL_TRUE, 0,
+                hostBits.size() * sizeof(cl_uint),
+                hostBits.data(), 0, nullptr, nullptr);
+            if (errSeed != CL_SUCCESS) {
+                std::cerr << "Initial seed write failed (err="
+                    << errSeed << ")\n";
+            }
+        }
+        else if (host.size() >= N) {
             cl_int errSeed = clEnqueueWriteBuffer(
                 queue, bufA, CL_TRUE, 0,
                 N * sizeof(cl_uchar),
@@ -182,153 +846,626 @@ void CLLife::step(uint32_t w, uint32_t h,
             std::cerr << "Warning: host grid too small to seed device\n";
         }
         seeded = true;
+
+        // The kernels only report births and deaths, so the populations
+        // start from the seed's.
+        if (host.size() >= N) {
+            speciesPop.assign(S + 1, 0);
+            for (uint32_t i = 0; i < N; ++i) {
+                if (host[i] != 0 && host[i] <= S) ++speciesPop[host[i]];
+            }
+            lastLiveCells = 0;
+            for (uint32_t sp = 1; sp <= S; ++sp) {
+                lastLiveCells += static_cast<uint32_t>(speciesPop[sp]);
+            }
+
+            if (mode == LifeMode::BitPlanes) grid_hash(hostBits.data(), hostBits.size(), hashLanes);
+            else grid_hash(host.data(), N, hashLanes);
+            record_hash(generation);
+        }
+
+        if (mode == LifeMode::Temporal && !validate_temporal(W, H, S)) {
+            std::cerr << "Warning: temporal blocking (K=" << temporalSteps
+                << ") does not match single-step output, using tiled kernel\n";
+            mode = LifeMode::Tiled;
+            create_step_kernels();
+        }
+        if (benchSpecialization && specialize && is_pow2(W)) {
+            benchmark_specialization(W, H, S);
+        }
     }
+    return true;
+}
+
+void CLLife::step(uint32_t w, uint32_t h,
+    uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    const uint32_t S = numSpecies;
+    const uint32_t W = w;
+    const uint32_t H = h;
+
+    if (!prepare(W, H, S, host)) return;
 
     cl_event evtKernel = nullptr;
 
-    if (!flip) {
-        clSetKernelArg(kAB, 0, sizeof(cl_mem), &bufA);
-        clSetKernelArg(kAB, 1, sizeof(cl_mem), &bufB);
-        clSetKernelArg(kAB, 2, sizeof(cl_uint), &W);
-        clSetKernelArg(kAB, 3, sizeof(cl_uint), &H);
-        clSetKernelArg(kAB, 4, sizeof(cl_uint), &S);
+    cl_kernel k = !flip ? kAB : kBA;
+    cl_mem src = !flip ? bufA : bufB;
+    cl_mem dst = !flip ? bufB : bufA;
+
+    cl_event evtCompact = nullptr;
+
+    // dst may still be being read back for display on the transfer queue.
+    cl_event& dstRead = bufReadEvt[!flip ? 1 : 0];
+    if (dstRead) {
+        clEnqueueBarrierWithWaitList(queue, 1, &dstRead, nullptr);
+        clReleaseEvent(dstRead);
+        dstRead = nullptr;
+    }
+
+    const bool stats = begin_stats();
+    clSetKernelArg(k, 5, sizeof(cl_mem), stats ? &statsBuf[statsParity] : nullptr);
 
-        clEnqueueNDRangeKernel(queue, kAB, 1, nullptr,
-            &global, (localSize ? &localSize : nullptr),
-            0, nullptr, &evtKernel);
+    if (mode == LifeMode::ActiveTiles) {
+        enqueue_active(k, src, dst, W, H, S, &evtCompact, &evtKernel);
     }
     else {
-        clSetKernelArg(kBA, 0, sizeof(cl_mem), &bufB);
-        clSetKernelArg(kBA, 1, sizeof(cl_mem), &bufA);
-        clSetKernelArg(kBA, 2, sizeof(cl_uint), &W);
-        clSetKernelArg(kBA, 3, sizeof(cl_uint), &H);
-        clSetKernelArg(kBA, 4, sizeof(cl_uint), &S);
+        enqueue_step(k, src, dst, W, H, S, &evtKernel);
+    }
 
-        clEnqueueNDRangeKernel(queue, kBA, 1, nullptr,
-            &global, (localSize ? &localSize : nullptr),
-            0, nullptr, &evtKernel);
+    const uint32_t gens = (mode == LifeMode::Temporal) ? temporalSteps : 1;
+    if (stats) {
+        poll_stats(false);
+        queue_stats(evtKernel, generation + gens);
     }
-    
-    clWaitForEvents(1, &evtKernel);
-    cl_ulong t0 = 0, t1 = 0;
-    clGetEventProfilingInfo(evtKernel, CL_PROFILING_COMMAND_START,
-        sizeof(t0), &t0, nullptr);
-    clGetEventProfilingInfo(evtKernel, CL_PROFILING_COMMAND_END,
-        sizeof(t1), &t1, nullptr);
-    clReleaseEvent(evtKernel);
 
-    lastKernelMs = static_cast<double>(t1 - t0) * 1e-6;
+    if (framesInFlight > 1) {
+        // Time the previous launch instead; it is ahead of this one in the
+        // queue, so waiting on it never drains the device.
+        clFlush(queue);
+        if (stepEvt) {
+            lastKernelMs = step_ms(stepEvt, stepCompactEvt);
+            clReleaseEvent(stepEvt);
+        }
+        if (stepCompactEvt) clReleaseEvent(stepCompactEvt);
+        stepEvt = evtKernel;
+        stepCompactEvt = evtCompact;
+    }
+    else {
+        lastKernelMs = step_ms(evtKernel, evtCompact);
+        if (evtCompact) clReleaseEvent(evtCompact);
+        clReleaseEvent(evtKernel);
+    }
+
+    hostDirty = true;
+
+    generation += gens;
+    flip = !flip;
+}
+
+// Enqueues all launches on the pre-bound kAB/kBA pair and waits once at the
+// end. Births, deaths and hash changes are additive, so the whole batch
+// counts into one stats buffer and is retired as a single record.
+void CLLife::step_n(uint32_t w, uint32_t h,
+    uint32_t numSpecies,
+    std::vector<unsigned char>& host,
+    uint32_t steps)
+{
+    const uint32_t S = numSpecies;
+    const uint32_t W = w;
+    const uint32_t H = h;
+
+    if (steps == 0 || !prepare(W, H, S, host)) return;
+
+    for (cl_event& e : bufReadEvt) {
+        if (!e) continue;
+        clEnqueueBarrierWithWaitList(queue, 1, &e, nullptr);
+        clReleaseEvent(e);
+        e = nullptr;
+    }
+    if (stepCompactEvt) clReleaseEvent(stepCompactEvt);
+    if (stepEvt)        clReleaseEvent(stepEvt);
+    stepCompactEvt = nullptr;
+    stepEvt = nullptr;
+
+    const bool stats = begin_stats();
+    cl_mem statsArg = stats ? statsBuf[statsParity] : nullptr;
+    clSetKernelArg(kAB, 5, sizeof(cl_mem), stats ? &statsArg : nullptr);
+    clSetKernelArg(kBA, 5, sizeof(cl_mem), stats ? &statsArg : nullptr);
+
+    // Both directions are bound once; the loop below only enqueues.
+    const bool active = mode == LifeMode::ActiveTiles;
+    if (!active) {
+        set_step_args(kAB, bufA, bufB, W, H, S);
+        set_step_args(kBA, bufB, bufA, W, H, S);
+    }
+
+    // Profiling events for an evenly spaced sample of the launches, always
+    // including the first and the last; they are only read after the final
+    // wait, so timing never stalls the queue.
+    const uint32_t stride = std::max(1u, steps / STEP_N_SAMPLES);
+    std::vector<std::pair<cl_event, cl_event>> samples;
+    samples.reserve(steps / stride + 2);
+
+    for (uint32_t i = 0; i < steps; ++i) {
+        const bool sample = (i % stride == 0) || (i + 1 == steps);
+        cl_event evtKernel = nullptr;
+        cl_event evtCompact = nullptr;
+        cl_kernel k = !flip ? kAB : kBA;
 
-    if (pipeProducer && pipeConsumer && statsPipe && statsBuffer) {
         cl_int err = CL_SUCCESS;
+        if (active) {
+            enqueue_active(k, !flip ? bufA : bufB, !flip ? bufB : bufA, W, H, S,
+                sample ? &evtCompact : nullptr, sample ? &evtKernel : nullptr);
+        }
+        else {
+            err = launch_step(k, W, H, sample ? &evtKernel : nullptr);
+        }
+        if (err != CL_SUCCESS) {
+            std::cerr << "step_n launch " << i << " failed (err=" << err << ")\n";
+            break;
+        }
+        if (sample) samples.emplace_back(evtKernel, evtCompact);
+
+        generation += (mode == LifeMode::Temporal) ? temporalSteps : 1;
+        flip = !flip;
+    }
+    hostDirty = true;
+    if (samples.empty()) return;
+
+    cl_event last = samples.back().first;
+    if (stats) {
+        poll_stats(false);
+        queue_stats(last, generation);
+    }
+    clFlush(queue);
+    clWaitForEvents(1, &last);
+
+    double total = 0.0;
+    for (const auto& e : samples) total += step_ms(e.first, e.second);
+    lastKernelMs = total / samples.size();
+
+    cl_ulong t0 = 0, t1 = 0;
+    clGetEventProfilingInfo(samples.front().second ? samples.front().second : samples.front().first,
+        CL_PROFILING_COMMAND_START, sizeof(t0), &t0, nullptr);
+    clGetEventProfilingInfo(last, CL_PROFILING_COMMAND_END, sizeof(t1), &t1, nullptr);
+    lastBatchMs = static_cast<double>(t1 - t0) * 1e-6;
+    lastBatchSteps = steps;
+
+    for (auto& e : samples) {
+        if (e.second) clReleaseEvent(e.second);
+        if (framesInFlight > 1 && e.first == last) continue;
+        clReleaseEvent(e.first);
+    }
+    // sync_host() orders its reads after stepEvt.
+    if (framesInFlight > 1) stepEvt = last;
+}
+
+AutoStop CLLife::run_autonomous(uint32_t w, uint32_t h,
+    uint32_t numSpecies,
+    std::vector<unsigned char>& host,
+    uint64_t budget, int64_t minLive, int64_t maxLive)
+{
+    const uint32_t S = numSpecies;
+    const uint32_t W = w;
+    const uint32_t H = h;
+
+    if (!prepare(W, H, S, host)) return AutoStop::Failed;
+
+    // Retires every stats read, so speciesPop and the hash are current.
+    drain_pipeline();
+
+    auto live_now = [&]() {
+        int64_t live = 0;
+        for (uint32_t sp = 1; sp <= S && sp < speciesPop.size(); ++sp) live += speciesPop[sp];
+        return live;
+    };
+
+    uint64_t done = 0;
+    if (scheduleK && ctlBuf && statsBuf[0]) {
+        // Laid out as the CTL_* slots in kernel_source.h.
+        std::vector<cl_long> ctl(CTL_POP + 1 + S, 0);
+        ctl[0] = static_cast<cl_long>(budget);
+        ctl[4] = minLive;
+        ctl[5] = maxLive;
+        ctl[6] = hashLanes[0];
+        ctl[7] = hashLanes[1];
+        for (uint32_t sp = 1; sp <= S; ++sp) ctl[CTL_POP + sp] = speciesPop[sp];
 
-        cl_mem curGrid = (!flip ? bufB : bufA);
-        size_t pipeGlobal = pipeWorkItems;
+        const cl_int zero = 0;
+        clEnqueueFillBuffer(queue, statsBuf[0], &zero, sizeof(zero),
+            0, STATS_INTS * sizeof(cl_int), 0, nullptr, nullptr);
+        cl_int err = clEnqueueWriteBuffer(queue, ctlBuf, CL_FALSE, 0,
+            ctl.size() * sizeof(cl_long), ctl.data(), 0, nullptr, nullptr);
 
-        err = clSetKernelArg(pipeProducer, 0, sizeof(cl_mem), &curGrid);
-        err |= clSetKernelArg(pipeProducer, 1, sizeof(cl_uint), &N);
-        err |= clSetKernelArg(pipeProducer, 2, sizeof(cl_mem), &statsPipe);
+        cl_mem src = !flip ? bufA : bufB;
+        cl_mem dst = !flip ? bufB : bufA;
+        const cl_uint group = static_cast<cl_uint>(localSize ? localSize : 64);
+        err |= clSetKernelArg(scheduleK, 0, sizeof(cl_mem), &src);
+        err |= clSetKernelArg(scheduleK, 1, sizeof(cl_mem), &dst);
+        err |= clSetKernelArg(scheduleK, 2, sizeof(cl_uint), &W);
+        err |= clSetKernelArg(scheduleK, 3, sizeof(cl_uint), &H);
+        err |= clSetKernelArg(scheduleK, 4, sizeof(cl_uint), &S);
+        err |= clSetKernelArg(scheduleK, 5, sizeof(cl_mem), &statsBuf[0]);
+        err |= clSetKernelArg(scheduleK, 6, sizeof(cl_mem), &ctlBuf);
+        err |= clSetKernelArg(scheduleK, 7, sizeof(cl_uint), &group);
 
+        // The scheduler's event completes only once every generation it
+        // enqueued has.
+        cl_event evt = nullptr;
+        const size_t one = 1;
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(queue, scheduleK, 1, nullptr,
+                &one, &one, 0, nullptr, &evt);
+        }
         if (err == CL_SUCCESS) {
-            cl_event evtProd = nullptr;
-            err = clEnqueueNDRangeKernel(queue, pipeProducer, 1, nullptr,
-                &pipeGlobal, nullptr,
-                0, nullptr, &evtProd);
-            if (err == CL_SUCCESS) {
-                clWaitForEvents(1, &evtProd);
-                clReleaseEvent(evtProd);
+            err = clEnqueueReadBuffer(queue, ctlBuf, CL_TRUE, 0,
+                ctl.size() * sizeof(cl_long), ctl.data(), 1, &evt, nullptr);
+        }
+        if (evt) {
+            cl_ulong t0 = 0, t1 = 0;
+            clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_START, sizeof(t0), &t0, nullptr);
+            clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_END, sizeof(t1), &t1, nullptr);
+            lastBatchMs = static_cast<double>(t1 - t0) * 1e-6;
+            clReleaseEvent(evt);
+        }
+
+        if (err == CL_SUCCESS) {
+            done = static_cast<uint64_t>(ctl[1]);
+            generation += done;
+            if (done & 1) flip = !flip;
+            hostDirty = true;
+            hashLanes[0] = static_cast<uint32_t>(ctl[6]);
+            hashLanes[1] = static_cast<uint32_t>(ctl[7]);
+            for (uint32_t sp = 1; sp <= S; ++sp) speciesPop[sp] = ctl[CTL_POP + sp];
+            lastLiveCells = static_cast<uint32_t>(ctl[3]);
+            lastBatchSteps = static_cast<uint32_t>(std::min<uint64_t>(done, UINT32_MAX));
+            lastKernelMs = done ? lastBatchMs / done : 0.0;
+            record_hash(generation);
+
+            // The scheduler does not track tiles, so all of them are
+            // stepped again next time.
+            if (mode == LifeMode::ActiveTiles) {
+                const cl_uint oneTile = 1;
+                clEnqueueFillBuffer(queue, tilesChanged, &oneTile, sizeof(oneTile), 0,
+                    static_cast<size_t>(tilesX) * tilesY * sizeof(cl_uint), 0, nullptr, nullptr);
             }
-            else {
-                std::cerr << "pipeProducer enqueue failed (err=" << err << ")\n";
+
+            const cl_long reason = ctl[2];
+            if (reason >= 1 && reason <= 3) return static_cast<AutoStop>(reason);
+        }
+        std::cerr << "Warning: device-side enqueue failed after " << done
+            << " generations (err=" << err << "), continuing on the host queue\n";
+    }
+
+    // Host-queue fallback: the same checks between batches, which needs
+    // the populations counted.
+    const bool checks = minLive >= 0 || maxLive > 0;
+    const bool keepStats = collectStats;
+    if (checks) collectStats = true;
+
+    const uint64_t perLaunch = (mode == LifeMode::Temporal) ? temporalSteps : 1;
+    AutoStop stop = AutoStop::Budget;
+    for (;;) {
+        const int64_t live = live_now();
+        if (done >= budget)                 { stop = AutoStop::Budget; break; }
+        if (minLive >= 0 && live <= minLive) { stop = AutoStop::Low; break; }
+        if (maxLive > 0 && live >= maxLive)  { stop = AutoStop::High; break; }
+
+        const uint64_t launches = std::min<uint64_t>(AUTO_BATCH,
+            (budget - done + perLaunch - 1) / perLaunch);
+        const uint64_t before = generation;
+        step_n(W, H, S, host, static_cast<uint32_t>(launches));
+        if (generation == before) { stop = AutoStop::Failed; break; }
+        done += generation - before;
+        if (checks) poll_stats(true);
+    }
+    collectStats = keepStats;
+    return stop;
+}
+
+bool CLLife::begin_stats()
+{
+    // The stats buffer is cleared once its previous read has finished.
+    const bool stats = collectStats && statsBuf[0] && statsBuf[1];
+    if (stats) {
+        const cl_int zero = 0;
+        cl_event& prevRead = statsBufRead[statsParity];
+        clEnqueueFillBuffer(queue, statsBuf[statsParity], &zero, sizeof(zero),
+            0, STATS_INTS * sizeof(cl_int), prevRead ? 1 : 0,
+            prevRead ? &prevRead : nullptr, nullptr);
+        if (prevRead) clReleaseEvent(prevRead);
+        prevRead = nullptr;
+    }
+    return stats;
+}
+
+void CLLife::queue_stats(cl_event after, uint64_t gen)
+{
+    if (statsPending == STATS_RING) {
+        clWaitForEvents(1, &statsReads[statsHead].evt);
+        poll_stats(false);
+    }
+
+    cl_mem buf = statsBuf[statsParity];
+    cl_event copied = nullptr;
+    if (mode == LifeMode::ActiveTiles) {
+        clEnqueueCopyBuffer(queue, tilesCount, buf, 0, 2 * STATS_BINS * sizeof(cl_int),
+            sizeof(cl_uint), 0, nullptr, &copied);
+        after = copied;
+    }
+
+    // On the transfer queue when there is one, so the read does not sit
+    // between two step kernels.
+    cl_command_queue q = xferQueue ? xferQueue : queue;
+    StatsRead& r = statsReads[(statsHead + statsPending) % STATS_RING];
+    r.generation = gen;
+    r.counts.resize(STATS_INTS);
+    cl_int err = clEnqueueReadBuffer(q, buf, CL_FALSE, 0, STATS_INTS * sizeof(cl_int),
+        r.counts.data(), after ? 1 : 0, after ? &after : nullptr, &r.evt);
+    if (copied) clReleaseEvent(copied);
+    if (err != CL_SUCCESS) {
+        std::cerr << "Stats read failed (err=" << err << ")\n";
+        r.evt = nullptr;
+        return;
+    }
+    if (q != queue) clFlush(q);
+
+    clRetainEvent(r.evt);
+    statsBufRead[statsParity] = r.evt;
+    statsParity ^= 1;
+    ++statsPending;
+}
+
+void CLLife::poll_stats(bool wait)
+{
+    while (statsPending) {
+        StatsRead& r = statsReads[statsHead];
+        if (wait) clWaitForEvents(1, &r.evt);
+
+        cl_int status = CL_QUEUED;
+        clGetEventInfo(r.evt, CL_EVENT_COMMAND_EXECUTION_STATUS,
+            sizeof(status), &status, nullptr);
+        if (status > CL_COMPLETE) break;
+
+        clReleaseEvent(r.evt);
+        r.evt = nullptr;
+        statsHead = (statsHead + 1) % STATS_RING;
+        --statsPending;
+        if (status != CL_COMPLETE) continue;
+
+        const cl_int* births = r.counts.data();
+        const cl_int* deaths = births + STATS_BINS;
+        uint64_t b = 0, d = 0;
+        int64_t live = 0;
+        for (uint32_t sp = 1; sp <= gridNS && sp < speciesPop.size(); ++sp) {
+            speciesPop[sp] += births[sp] - deaths[sp];
+            b += static_cast<uint64_t>(births[sp]);
+            d += static_cast<uint64_t>(deaths[sp]);
+            live += speciesPop[sp];
+        }
+        lastBirths = b;
+        lastDeaths = d;
+        lastLiveCells = static_cast<uint32_t>(live);
+        if (mode == LifeMode::ActiveTiles) {
+            activeTiles = static_cast<cl_uint>(r.counts[2 * STATS_BINS]);
+            lastActiveFraction = static_cast<double>(activeTiles)
+                / (static_cast<double>(tilesX) * tilesY);
+        }
+        if (statsLog) {
+            statsLog->append(r.generation, gridNS, speciesPop.data(), births, deaths);
+        }
+        hashLanes[0] += static_cast<uint32_t>(r.counts[2 * STATS_BINS + 1]);
+        hashLanes[1] += static_cast<uint32_t>(r.counts[2 * STATS_BINS + 2]);
+        record_hash(r.generation);
+    }
+}
+
+void CLLife::record_hash(uint64_t gen)
+{
+    if (!cycleDetect || hashRing.empty()) return;
+
+    const uint64_t hash = (static_cast<uint64_t>(hashLanes[1]) << 32) | hashLanes[0];
+    if (!cyclePeriod) {
+        // The most recent match gives the shortest period. Empty slots
+        // hold UINT64_MAX and never compare below gen.
+        bool found = false;
+        uint64_t since = 0;
+        for (const auto& e : hashRing) {
+            if (e.first < gen && e.second == hash && (!found || e.first > since)) {
+                found = true;
+                since = e.first;
             }
         }
-        else {
-            std::cerr << "pipeProducer set args failed (err=" << err << ")\n";
+        if (found) {
+            cyclePeriod = gen - since;
+            cycleGeneration = gen;
         }
+    }
+    hashRing[hashRingHead] = { gen, hash };
+    hashRingHead = (hashRingHead + 1) % static_cast<uint32_t>(hashRing.size());
+}
 
-        if (err == CL_SUCCESS) {
-            cl_uint numItems = static_cast<cl_uint>(pipeWorkItems);
-
-            err = clSetKernelArg(pipeConsumer, 0, sizeof(cl_mem), &statsPipe);
-            err |= clSetKernelArg(pipeConsumer, 1, sizeof(cl_mem), &statsBuffer);
-            err |= clSetKernelArg(pipeConsumer, 2, sizeof(cl_uint), &numItems);
-
-            if (err == CL_SUCCESS) {
-                cl_event evtCons = nullptr;
-                err = clEnqueueNDRangeKernel(queue, pipeConsumer, 1, nullptr,
-                    &pipeGlobal, nullptr,
-                    0, nullptr, &evtCons);
-                if (err == CL_SUCCESS) {
-                    clWaitForEvents(1, &evtCons);
-                    clReleaseEvent(evtCons);
-
-                    std::vector<cl_uint> partial(pipeWorkItems);
-                    err = clEnqueueReadBuffer(queue, statsBuffer, CL_TRUE,
-                        0, pipeWorkItems * sizeof(cl_uint),
-                        partial.data(),
-                        0, nullptr, nullptr);
-                    if (err == CL_SUCCESS) {
-                        uint32_t total = 0;
-                        for (size_t i = 0; i < pipeWorkItems; ++i)
-                            total += partial[i];
-                        lastLiveCells = total;
-                    }
-                    else {
-                        std::cerr << "Read statsBuffer failed (err=" << err << ")\n";
-                    }
-                }
-                else {
-                    std::cerr << "pipeConsumer enqueue failed (err=" << err << ")\n";
-                }
+void CLLife::drain_pipeline()
+{
+    if (xferQueue) clFinish(xferQueue);
+    if (queue)     clFinish(queue);
+    poll_stats(true);
+
+    for (Readback& r : readbacks) {
+        if (r.evt) clReleaseEvent(r.evt);
+        r.evt = nullptr;
+    }
+    for (cl_event& e : bufReadEvt) {
+        if (e) clReleaseEvent(e);
+        e = nullptr;
+    }
+    if (stepCompactEvt) clReleaseEvent(stepCompactEvt);
+    if (stepEvt)        clReleaseEvent(stepEvt);
+    stepCompactEvt = nullptr;
+    stepEvt = nullptr;
+    for (cl_event& e : statsBufRead) {
+        if (e) clReleaseEvent(e);
+        e = nullptr;
+    }
+
+    readbacks.assign(framesInFlight, Readback());
+    readHead = 0;
+    readIssued = 0;
+}
+
+void CLLife::sync_host(std::vector<unsigned char>& host)
+{
+    if (framesInFlight > 1 && xferQueue) {
+        const size_t N = static_cast<size_t>(gridW) * gridH;
+        const bool fresh = hostDirty;
+
+        if (hostDirty && readIssued < framesInFlight) {
+            Readback& r = readbacks[readHead];
+            const int curIdx = !flip ? 0 : 1;
+            cl_mem cur = !flip ? bufA : bufB;
+
+            void* ptr = nullptr;
+            size_t bytes = 0;
+            if (mode == LifeMode::BitPlanes) {
+                r.bits.resize(hostBits.size());
+                ptr = r.bits.data();
+                bytes = r.bits.size() * sizeof(cl_uint);
             }
             else {
-                std::cerr << "pipeConsumer set args failed (err=" << err << ")\n";
+                r.cells.resize(N);
+                ptr = r.cells.data();
+                bytes = N * sizeof(cl_uchar);
             }
+
+            clEnqueueReadBuffer(xferQueue, cur, CL_FALSE, 0, bytes, ptr,
+                stepEvt ? 1 : 0, stepEvt ? &stepEvt : nullptr, &r.evt);
+            clFlush(xferQueue);
+
+            if (bufReadEvt[curIdx]) clReleaseEvent(bufReadEvt[curIdx]);
+            bufReadEvt[curIdx] = r.evt;
+            clRetainEvent(r.evt);
+
+            readHead = (readHead + 1) % framesInFlight;
+            ++readIssued;
+            hostDirty = false;
         }
+
+        // Keep framesInFlight - 1 reads queued while the simulation runs;
+        // once it stops, hand out whatever is left.
+        if (readIssued == 0 || (fresh && readIssued < framesInFlight)) return;
+
+        Readback& r = readbacks[(readHead + framesInFlight - readIssued) % framesInFlight];
+        clWaitForEvents(1, &r.evt);
+        clReleaseEvent(r.evt);
+        r.evt = nullptr;
+        --readIssued;
+
+        host.resize(N);
+        if (mode == LifeMode::BitPlanes) {
+            unpack_planes(r.bits, gridW, gridH, wordsPerRow, gridNS, host);
+        }
+        else {
+            host.swap(r.cells);
+        }
+        return;
     }
 
+    if (!hostDirty) return;
+
+    const size_t N = static_cast<size_t>(gridW) * gridH;
+    cl_mem cur = !flip ? bufA : bufB;
     host.resize(N);
 
-    if (!flip) {
-        clEnqueueReadBuffer(queue, bufB, CL_TRUE, 0,
-            N * sizeof(cl_uchar),
-            host.data(),
+    if (mode == LifeMode::BitPlanes) {
+        clEnqueueReadBuffer(queue, cur, CL_TRUE, 0,
+            hostBits.size() * sizeof(cl_uint),
+            hostBits.data(),
             0, nullptr, nullptr);
+        unpack_planes(hostBits, gridW, gridH, wordsPerRow, gridNS, host);
     }
     else {
-        clEnqueueReadBuffer(queue, bufA, CL_TRUE, 0,
+        clEnqueueReadBuffer(queue, cur, CL_TRUE, 0,
             N * sizeof(cl_uchar),
             host.data(),
             0, nullptr, nullptr);
     }
+    hostDirty = false;
+}
 
-    flip = !flip;
+bool CLLife::attach_gl_texture(cl_GLenum target, cl_GLuint tex)
+{
+    if (!glShared) return false;
+
+    if (glImage) clReleaseMemObject(glImage);
+    cl_int err = CL_SUCCESS;
+    glImage = clCreateFromGLTexture(context, CL_MEM_WRITE_ONLY,
+        target, 0, tex, &err);
+    if (err != CL_SUCCESS) {
+        std::cerr << "Warning: clCreateFromGLTexture failed (err="
+            << err << "), colorizing through the host\n";
+        glImage = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool CLLife::render_to_gl()
+{
+    // The caller must glFinish() first; this returns once CL has released
+    // the texture again.
+    if (!glImage || !colorizeK || !seeded) return false;
+
+    cl_mem cur = !flip ? bufA : bufB;
+    cl_int err = clEnqueueAcquireGLObjects(queue, 1, &glImage, 0, nullptr, nullptr);
+
+    err |= clSetKernelArg(colorizeK, 0, sizeof(cl_mem), &cur);
+    err |= clSetKernelArg(colorizeK, 1, sizeof(cl_mem), &glImage);
+    err |= clSetKernelArg(colorizeK, 2, sizeof(cl_mem), &paletteBuf);
+    err |= clSetKernelArg(colorizeK, 3, sizeof(cl_uint), &gridW);
+    err |= clSetKernelArg(colorizeK, 4, sizeof(cl_uint), &gridH);
+    if (mode == LifeMode::BitPlanes) {
+        err |= clSetKernelArg(colorizeK, 5, sizeof(cl_uint), &gridNS);
+        err |= clSetKernelArg(colorizeK, 6, sizeof(cl_uint), &wordsPerRow);
+    }
+
+    size_t global2[2] = { gridW, gridH };
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(queue, colorizeK, 2, nullptr,
+            global2, nullptr, 0, nullptr, nullptr);
+    }
+
+    clEnqueueReleaseGLObjects(queue, 1, &glImage, 0, nullptr, nullptr);
+    clFinish(queue);
+
+    if (err != CL_SUCCESS) {
+        std::cerr << "Warning: CL/GL colorize failed (err=" << err
+            << "), colorizing through the host\n";
+        return false;
+    }
+    return true;
 }
 
 void CLLife::shutdown()
 {
-    if (statsBuffer)  clReleaseMemObject(statsBuffer);
-    if (statsPipe)    clReleaseMemObject(statsPipe);
-    if (pipeConsumer) clReleaseKernel(pipeConsumer);
-    if (pipeProducer) clReleaseKernel(pipeProducer);
+    drain_pipeline();
+    release_grid();
+
+    if (glImage)      clReleaseMemObject(glImage);
+    glImage = nullptr;
 
-    if (kBA)      clReleaseKernel(kBA);
-    if (kAB)      clReleaseKernel(kAB);
-    if (program)  clReleaseProgram(program);
-    if (bufB)     clReleaseMemObject(bufB);
-    if (bufA)     clReleaseMemObject(bufA);
+    for (auto& entry : programs)
+        clReleaseProgram(entry.second);
+    programs.clear();
+    if (deviceQueue) clReleaseCommandQueue(deviceQueue);
+    if (xferQueue) clReleaseCommandQueue(xferQueue);
     if (queue)    clReleaseCommandQueue(queue);
     if (context)  clReleaseContext(context);
 
-    statsBuffer = nullptr;
-    statsPipe = nullptr;
-    pipeConsumer = nullptr;
-    pipeProducer = nullptr;
-    kBA = nullptr;
-    kAB = nullptr;
+    deviceQueue = nullptr;
+    xferQueue = nullptr;
     program = nullptr;
-    bufB = nullptr;
-    bufA = nullptr;
     queue = nullptr;
     context = nullptr;
+    gridW = gridH = gridNS = 0;
 }
@@ -1,38 +1,253 @@
 #pragma once
 #define CL_TARGET_OPENCL_VERSION 200
 #include <CL/cl.h>
+#include <CL/cl_gl.h>
+#include "life_engine.h"
+#include "stats_log.h"
 #include <vector>
 #include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
 
-struct CLLife {
+enum class LifeMode {
+    Global,
+    Tiled,
+    BitPlanes,
+    Temporal,
+    ActiveTiles
+};
+
+// Why run_autonomous() returned; matches CTL_REASON in kernel_source.h.
+enum class AutoStop {
+    Budget = 1,
+    Low,
+    High,
+    Failed
+};
+
+struct CLLife : LifeEngine {
     cl_context context = nullptr;
+    cl_device_id device = nullptr;
     cl_command_queue queue = nullptr;
+    cl_command_queue xferQueue = nullptr;
     cl_program program = nullptr;
+    const char* source = nullptr;
+    std::map<std::string, cl_program> programs;
     cl_kernel kAB = nullptr;
     cl_kernel kBA = nullptr;
     cl_mem bufA = nullptr;
     cl_mem bufB = nullptr;
-    cl_kernel pipeProducer = nullptr;
-    cl_kernel pipeConsumer = nullptr;
-    cl_mem    statsPipe = nullptr;
-    cl_mem    statsBuffer = nullptr;
+    cl_kernel tilesCompact = nullptr;
+    cl_mem    tilesChanged = nullptr;
+    cl_mem    tilesNext = nullptr;
+    cl_mem    tilesList = nullptr;
+    cl_mem    tilesCount = nullptr;
+    cl_uint   tilesX = 0;
+    cl_uint   tilesY = 0;
+    cl_uint   activeTiles = 0;
+    double    lastActiveFraction = 1.0;
     double lastKernelMs = 0.0;
+    // Device time from the first to the last launch of the latest step_n()
+    // batch; lastKernelMs then averages up to STEP_N_SAMPLES of its launches.
+    static constexpr uint32_t STEP_N_SAMPLES = 32;
+    double lastBatchMs = 0.0;
+    uint32_t lastBatchSteps = 0;
     
     bool flip = false;
 
+    LifeMode mode = LifeMode::Tiled;
     size_t workItems = 0;
     size_t localSize = 0;
-    size_t    pipeWorkItems = 64;
+    size_t tileW = 0;
+    size_t tileH = 0;
+    uint32_t temporalSteps = 4;
+    size_t temporalGroup = 0;
+    uint32_t temporalTileW = 0;
+    uint32_t temporalTileH = 0;
+    uint32_t wordsPerRow = 0;
+    std::vector<cl_uint> hostBits;
     uint32_t  lastLiveCells = 0;
     cl_uint computeUnits = 0;
+    uint64_t generation = 0;
+
+    uint32_t gridW = 0;
+    uint32_t gridH = 0;
+    uint32_t gridNS = 0;
+    bool     seeded = false;
+    bool     hostDirty = false;
+    bool     collectStats = true;
+    bool     specialize = true;
+    bool     benchSpecialization = false;
+    bool     wrap = false;
+    uint32_t birthMask = 1u << 3;
+    uint32_t surviveMask = (1u << 2) | (1u << 3);
+    double   genericKernelMs = 0.0;
+    double   specializedKernelMs = 0.0;
+
+    // Frames in flight: with more than one, sync_host() queues a non-blocking
+    // read of the newest generation on xferQueue and hands back the one
+    // issued framesInFlight - 1 calls earlier, so compute, transfer and
+    // display overlap.
+    struct Readback {
+        cl_event evt = nullptr;
+        std::vector<unsigned char> cells;
+        std::vector<cl_uint> bits;
+    };
+    uint32_t framesInFlight = 1;
+    std::vector<Readback> readbacks;
+    uint32_t readHead = 0;
+    uint32_t readIssued = 0;
+    cl_event stepEvt = nullptr;
+    cl_event stepCompactEvt = nullptr;
+    cl_event bufReadEvt[2] = { nullptr, nullptr };
+
+    // Per-launch births and deaths per species (a temporal launch sums them
+    // over its K generations), written by the step kernel into
+    // statsBuf[generation parity]: births at [s], deaths at
+    // [STATS_BINS + s], the active tile count at [2 * STATS_BINS] and the
+    // change of the two grid hash lanes after it. Reads are
+    // queued without blocking and retired in order by poll_stats() a step or
+    // more later, which keeps speciesPop, the last-step totals and the log
+    // up to date.
+    static constexpr uint32_t STATS_BINS = 256;
+    static constexpr uint32_t STATS_INTS = 2 * STATS_BINS + 3;
+    static constexpr uint32_t STATS_RING = 4;
+    struct StatsRead {
+        cl_event evt = nullptr;
+        uint64_t generation = 0;
+        std::vector<cl_int> counts;
+    };
+    cl_mem   statsBuf[2] = { nullptr, nullptr };
+    cl_event statsBufRead[2] = { nullptr, nullptr };
+    uint32_t statsParity = 0;
+    std::vector<StatsRead> statsReads;
+    uint32_t statsHead = 0;
+    uint32_t statsPending = 0;
+    std::vector<int64_t> speciesPop;
+    uint64_t lastBirths = 0;
+    uint64_t lastDeaths = 0;
+    StatsLog* statsLog = nullptr;
+
+    // Cycle detection: the running grid hash of every retired launch goes
+    // into a ring of the last cycleWindow hashes, and the first repeat sets
+    // cyclePeriod. Needs collectStats.
+    uint32_t hashLanes[2] = { 0, 0 };
+    bool     cycleDetect = true;
+    uint32_t cycleWindow = 64;
+    std::vector<std::pair<uint64_t, uint64_t>> hashRing;
+    uint32_t hashRingHead = 0;
+    uint64_t cyclePeriod = 0;
+    uint64_t cycleGeneration = 0;
+
+    // Autonomous runs: life_schedule chains generations from the default
+    // on-device queue, with its counters and populations in ctlBuf.
+    static constexpr uint32_t CTL_POP = 8;
+    static constexpr uint32_t AUTO_BATCH = 64;
+    bool             deviceEnqueue = false;
+    cl_command_queue deviceQueue = nullptr;
+    cl_kernel        scheduleK = nullptr;
+    cl_mem           ctlBuf = nullptr;
+
+    std::vector<cl_context_properties> glShareProps;
+    bool      glShared = false;
+    cl_mem    glImage = nullptr;
+    cl_kernel colorizeK = nullptr;
+    cl_mem    paletteBuf = nullptr;
 
     bool init(uint32_t w, uint32_t h, uint32_t numSpecies, const char* src);
-    void step(uint32_t w, uint32_t h, uint32_t numSpecies, std::vector<unsigned char>& host);
+    void step(uint32_t w, uint32_t h, uint32_t numSpecies, std::vector<unsigned char>& host) override;
+    void step_n(uint32_t w, uint32_t h, uint32_t numSpecies, std::vector<unsigned char>& host,
+        uint32_t steps) override;
+    void sync_host(std::vector<unsigned char>& host) override;
+
+    // Runs up to `budget` generations with no host work per generation,
+    // stopping early once the population is at or below `minLive` (< 0:
+    // never) or at or above `maxLive` (0: never). Without an on-device queue
+    // the same checks run between step_n() batches on the host queue.
+    AutoStop run_autonomous(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host, uint64_t budget, int64_t minLive, int64_t maxLive);
+    void set_mode(LifeMode m) {
+        mode = m;
+    }
+    void set_temporal_steps(uint32_t k) {
+        temporalSteps = k < 2 ? 2 : (k > 8 ? 8 : k);
+    }
     void set_work_items(size_t n) {
         workItems = n;
     }
     void set_local_size(size_t n) {
         localSize = n;
     }
-    void shutdown();
+    void set_specialize(bool on) {
+        specialize = on;
+    }
+    // Times the specialized step kernel against a generic build once the
+    // grid is seeded; costs an extra program build and launches.
+    void set_bench_specialization(bool on) {
+        benchSpecialization = on;
+    }
+    void set_wrap(bool on) {
+        wrap = on;
+    }
+    // Both must be set before the first step; the log receives every
+    // launch's record while stats are collected.
+    void set_collect_stats(bool on) {
+        collectStats = on;
+    }
+    void set_stats_log(StatsLog* log) {
+        statsLog = log;
+    }
+    void set_cycle_detection(bool on, uint32_t window = 64) {
+        cycleDetect = on;
+        cycleWindow = window < 2 ? 2 : window;
+        hashRing.assign(cycleWindow, { UINT64_MAX, 0 });
+        hashRingHead = 0;
+    }
+    uint64_t cycle_period() const override {
+        return cyclePeriod;
+    }
+    void skip(uint64_t generations) override {
+        generation += generations;
+    }
+    // Must be set before init(), which creates the on-device queue.
+    void set_device_enqueue(bool on) {
+        deviceEnqueue = on;
+    }
+    void set_frames_in_flight(uint32_t n) {
+        framesInFlight = n < 1 ? 1 : (n > 3 ? 3 : n);
+    }
+    bool set_rule(const char* rule);
+
+    // GL context properties (CL_GL_CONTEXT_KHR plus the WGL/GLX display
+    // handle) to share with; must be set before init().
+    void set_gl_sharing(const std::vector<cl_context_properties>& props) {
+        glShareProps = props;
+    }
+    bool attach_gl_texture(cl_GLenum target, cl_GLuint tex);
+    bool render_to_gl();
+    void shutdown() override;
+
+    std::string build_options(uint32_t w, uint32_t h, uint32_t numSpecies, bool specialized) const;
+    cl_program get_program(const std::string& opts);
+    bool configure(uint32_t w, uint32_t h, uint32_t numSpecies);
+    void release_grid();
+    void drain_pipeline();
+    bool prepare(uint32_t w, uint32_t h, uint32_t numSpecies, std::vector<unsigned char>& host);
+    cl_int set_step_args(cl_kernel k, cl_mem src, cl_mem dst,
+        uint32_t w, uint32_t h, uint32_t numSpecies);
+    cl_int launch_step(cl_kernel k, uint32_t w, uint32_t h, cl_event* evt);
+    cl_int enqueue_step(cl_kernel k, cl_mem src, cl_mem dst,
+        uint32_t w, uint32_t h, uint32_t numSpecies, cl_event* evt);
+    void enqueue_active(cl_kernel k, cl_mem src, cl_mem dst,
+        uint32_t w, uint32_t h, uint32_t numSpecies, cl_event* evtCompact, cl_event* evtKernel);
+    bool begin_stats();
+    void benchmark_specialization(uint32_t w, uint32_t h, uint32_t numSpecies);
+    void queue_stats(cl_event after, uint64_t gen);
+    void poll_stats(bool wait);
+    void record_hash(uint64_t gen);
+
+    bool create_step_kernels();
+    bool create_tile_tracking(uint32_t w, uint32_t h);
+    bool validate_temporal(uint32_t w, uint32_t h, uint32_t numSpecies);
 };
@@ -0,0 +1,450 @@
+#include "cl_split_life.h"
+#include "program_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+static cl_device_id first_device(cl_device_type type)
+{
+    cl_uint numPlatforms = 0;
+    if (clGetPlatformIDs(0, nullptr, &numPlatforms) != CL_SUCCESS || numPlatforms == 0)
+        return nullptr;
+
+    std::vector<cl_platform_id> plats(numPlatforms);
+    clGetPlatformIDs(numPlatforms, plats.data(), nullptr);
+
+    for (cl_uint i = 0; i < numPlatforms; ++i) {
+        cl_uint numDevices = 0;
+        if (clGetDeviceIDs(plats[i], type, 0, nullptr, &numDevices)
+            != CL_SUCCESS || numDevices == 0)
+            continue;
+
+        std::vector<cl_device_id> devs(numDevices);
+        clGetDeviceIDs(plats[i], type, numDevices, devs.data(), nullptr);
+        return devs[0];
+    }
+    return nullptr;
+}
+
+// Partitions a device into `parts` equal sub-devices, or returns the
+// device itself when it cannot be split.
+static std::vector<cl_device_id> split_device(cl_device_id dev, uint32_t parts)
+{
+    cl_uint cu = 0;
+    clGetDeviceInfo(dev, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cu), &cu, nullptr);
+    if (parts < 2 || cu < parts) return { dev };
+
+    const cl_device_partition_property props[] = {
+        CL_DEVICE_PARTITION_EQUALLY,
+        static_cast<cl_device_partition_property>(cu / parts),
+        0
+    };
+    cl_uint n = 0;
+    if (clCreateSubDevices(dev, props, 0, nullptr, &n) != CL_SUCCESS || n == 0) {
+        std::cerr << "Warning: clCreateSubDevices failed, using whole device\n";
+        return { dev };
+    }
+
+    std::vector<cl_device_id> subs(n);
+    clCreateSubDevices(dev, props, n, subs.data(), nullptr);
+    while (subs.size() > parts) {
+        clReleaseDevice(subs.back());
+        subs.pop_back();
+    }
+    return subs;
+}
+
+static void release_band(CLSplitLife::Band& b)
+{
+    for (cl_event e : b.events) clReleaseEvent(e);
+    if (b.bufB)    clReleaseMemObject(b.bufB);
+    if (b.bufA)    clReleaseMemObject(b.bufA);
+    if (b.kernel)  clReleaseKernel(b.kernel);
+    if (b.program) clReleaseProgram(b.program);
+    if (b.queue)   clReleaseCommandQueue(b.queue);
+    if (b.context) clReleaseContext(b.context);
+    if (b.subDevice && b.device) clReleaseDevice(b.device);
+    b = CLSplitLife::Band();
+}
+
+bool CLSplitLife::add_device(cl_device_id dev, cl_device_type type, bool sub)
+{
+    Band b;
+    b.device = dev;
+    b.type = type;
+    b.subDevice = sub;
+
+    char name[256] = {};
+    clGetDeviceInfo(dev, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+    b.name = name;
+    if (sub) b.name += " #" + std::to_string(bands.size());
+
+    cl_int err = CL_SUCCESS;
+    b.context = clCreateContext(nullptr, 1, &dev, nullptr, nullptr, &err);
+    if (err == CL_SUCCESS) {
+        const cl_queue_properties qprops[] = {
+            CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0
+        };
+        b.queue = clCreateCommandQueueWithProperties(b.context, dev, qprops, &err);
+    }
+    if (err == CL_SUCCESS) {
+        std::string log;
+        b.program = build_program(b.context, dev, source, "-cl-std=CL2.0", log);
+        if (!b.program) {
+            std::cerr << "CL build error on " << b.name << ":\n" << log << "\n";
+            err = CL_BUILD_PROGRAM_FAILURE;
+        }
+    }
+    if (err == CL_SUCCESS) {
+        b.kernel = clCreateKernel(b.program, "life_step", &err);
+    }
+
+    if (err != CL_SUCCESS) {
+        std::cerr << "Warning: skipping device " << b.name
+            << " for split engine (err=" << err << ")\n";
+        release_band(b);
+        return false;
+    }
+
+    bands.push_back(b);
+    return true;
+}
+
+bool CLSplitLife::init(uint32_t w, uint32_t h, uint32_t numSpecies, const char* src)
+{
+    source = src;
+
+    std::vector<cl_device_id> devices;
+    if (allDevices) {
+        cl_uint numPlatforms = 0;
+        if (clGetPlatformIDs(0, nullptr, &numPlatforms) == CL_SUCCESS && numPlatforms) {
+            std::vector<cl_platform_id> plats(numPlatforms);
+            clGetPlatformIDs(numPlatforms, plats.data(), nullptr);
+            for (cl_platform_id p : plats) {
+                cl_uint numDevices = 0;
+                if (clGetDeviceIDs(p, CL_DEVICE_TYPE_ALL, 0, nullptr, &numDevices)
+                    != CL_SUCCESS || numDevices == 0)
+                    continue;
+                std::vector<cl_device_id> devs(numDevices);
+                clGetDeviceIDs(p, CL_DEVICE_TYPE_ALL, numDevices, devs.data(), nullptr);
+                devices.insert(devices.end(), devs.begin(), devs.end());
+            }
+        }
+    }
+    else {
+        if (cl_device_id gpu = first_device(CL_DEVICE_TYPE_GPU)) devices.push_back(gpu);
+        if (cl_device_id cpu = first_device(CL_DEVICE_TYPE_CPU)) devices.push_back(cpu);
+    }
+
+    // CPU devices can be carved into sub-devices so a GPU-less host still
+    // exercises the multi-slab path.
+    for (cl_device_id dev : devices) {
+        cl_device_type type = 0;
+        clGetDeviceInfo(dev, CL_DEVICE_TYPE, sizeof(type), &type, nullptr);
+
+        std::vector<cl_device_id> parts = (type & CL_DEVICE_TYPE_CPU)
+            ? split_device(dev, subDevices)
+            : std::vector<cl_device_id>{ dev };
+        const bool sub = parts.size() > 1 || parts[0] != dev;
+        for (cl_device_id part : parts) add_device(part, type, sub);
+    }
+
+    if (bands.empty()) {
+        std::cerr << "No OpenCL devices available for split engine\n";
+        return false;
+    }
+
+    // Starting guess only; rebalance() replaces it from measured times.
+    double total = 0.0;
+    for (Band& b : bands) {
+        b.share = (b.type == CL_DEVICE_TYPE_GPU) ? 3.0 : 1.0;
+        total += b.share;
+    }
+    for (Band& b : bands) b.share /= total;
+
+    gridW = w;
+    gridH = h;
+    gridNS = numSpecies;
+    partition(h);
+    if (!allocate(w)) return false;
+
+    seeded = false;
+    hostDirty = false;
+    flip = false;
+    generation = 0;
+    sinceRebalance = 0;
+    return true;
+}
+
+void CLSplitLife::partition(uint32_t h)
+{
+    const uint32_t n = static_cast<uint32_t>(bands.size());
+    uint32_t y = 0;
+    double acc = 0.0;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        Band& b = bands[i];
+        acc += b.share;
+
+        uint32_t end = (i + 1 == n) ? h
+            : static_cast<uint32_t>(std::lround(acc * h));
+        const uint32_t left = n - 1 - i;
+        end = std::max(end, std::min(y + 1, h));
+        end = std::min(end, h > left ? h - left : h);
+
+        b.y0 = y;
+        b.y1 = end;
+        b.haloTop = std::min(halo, b.y0);
+        b.haloBot = std::min(halo, h - b.y1);
+        y = end;
+    }
+}
+
+bool CLSplitLife::allocate(uint32_t w)
+{
+    for (Band& b : bands) {
+        if (b.bufB) clReleaseMemObject(b.bufB);
+        if (b.bufA) clReleaseMemObject(b.bufA);
+        b.bufA = b.bufB = nullptr;
+
+        const size_t bytes = static_cast<size_t>(w) * std::max(b.local_rows(), 1u);
+        cl_int err = CL_SUCCESS;
+        b.bufA = clCreateBuffer(b.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        if (err == CL_SUCCESS)
+            b.bufB = clCreateBuffer(b.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            std::cerr << "Failed to create band buffers on " << b.name
+                << " (err = " << err << ")\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void CLSplitLife::seed(const std::vector<unsigned char>& host)
+{
+    const size_t W = gridW;
+    for (Band& b : bands) {
+        if (!b.rows()) continue;
+        const size_t first = b.y0 - b.haloTop;
+        clEnqueueWriteBuffer(b.queue, b.bufA, CL_TRUE, 0,
+            W * b.local_rows(), host.data() + first * W,
+            0, nullptr, nullptr);
+    }
+    flip = false;
+    hostDirty = false;
+    sinceExchange = 0;
+}
+
+// Waits for every band and takes the kernel times of the launches queued
+// since the last wait.
+void CLSplitLife::finish()
+{
+    for (Band& b : bands) clFinish(b.queue);
+    for (Band& b : bands) {
+        for (cl_event e : b.events) {
+            cl_ulong k0 = 0, k1 = 0;
+            clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_START, sizeof(k0), &k0, nullptr);
+            clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_END, sizeof(k1), &k1, nullptr);
+            clReleaseEvent(e);
+
+            b.lastKernelMs = static_cast<double>(k1 - k0) * 1e-6;
+            b.accumMs += b.lastKernelMs;
+        }
+        b.events.clear();
+    }
+}
+
+// Copies the interior rows that fall inside some other band's halo into
+// `edges`, then writes them out as halos. Only these rows cross devices.
+void CLSplitLife::exchange_edges()
+{
+    const size_t W = gridW;
+    edges.resize(W * gridH);
+    for (Band& b : bands) {
+        if (!b.rows()) continue;
+        cl_mem cur = !flip ? b.bufA : b.bufB;
+        const uint32_t first = b.y0 - b.haloTop;
+        for (const Band& o : bands) {
+            if (&o == &b || !o.rows()) continue;
+            const uint32_t ranges[2][2] = {
+                { o.y0 - o.haloTop, o.y0 },
+                { o.y1, o.y1 + o.haloBot },
+            };
+            for (const auto& r : ranges) {
+                const uint32_t lo = std::max(r[0], b.y0);
+                const uint32_t hi = std::min(r[1], b.y1);
+                if (lo >= hi) continue;
+                clEnqueueReadBuffer(b.queue, cur, CL_FALSE,
+                    W * (lo - first), W * (hi - lo), edges.data() + W * lo,
+                    0, nullptr, nullptr);
+            }
+        }
+    }
+    finish();
+    exchange_halos(edges);
+}
+
+void CLSplitLife::exchange_halos(const std::vector<unsigned char>& rows)
+{
+    const size_t W = gridW;
+    for (Band& b : bands) {
+        if (!b.rows()) continue;
+        cl_mem src = !flip ? b.bufA : b.bufB;
+        if (b.haloTop) {
+            clEnqueueWriteBuffer(b.queue, src, CL_FALSE, 0,
+                W * b.haloTop, rows.data() + (b.y0 - b.haloTop) * W,
+                0, nullptr, nullptr);
+        }
+        if (b.haloBot) {
+            clEnqueueWriteBuffer(b.queue, src, CL_FALSE,
+                W * (b.haloTop + b.rows()), W * b.haloBot,
+                rows.data() + static_cast<size_t>(b.y1) * W,
+                0, nullptr, nullptr);
+        }
+    }
+    // `rows` is overwritten by the next exchange.
+    for (Band& b : bands) clFinish(b.queue);
+}
+
+void CLSplitLife::rebalance(uint32_t h, std::vector<unsigned char>& host)
+{
+    std::vector<double> rate(bands.size(), 0.0);
+    double total = 0.0;
+    for (size_t i = 0; i < bands.size(); ++i) {
+        const Band& b = bands[i];
+        if (b.accumMs <= 0.0 || !b.rows()) return;
+        rate[i] = b.rows() * static_cast<double>(sinceRebalance) / b.accumMs;
+        total += rate[i];
+    }
+
+    std::vector<Band> before = bands;
+    for (size_t i = 0; i < bands.size(); ++i) {
+        bands[i].share = 0.5 * bands[i].share + 0.5 * rate[i] / total;
+        bands[i].accumMs = 0.0;
+    }
+    sinceRebalance = 0;
+
+    partition(h);
+
+    // Re-splitting costs a full re-seed, so ignore small drifts.
+    const uint32_t minMove = std::max(1u, h / 128);
+    bool moved = false;
+    for (size_t i = 0; i < bands.size(); ++i) {
+        const uint32_t a = before[i].y1, b = bands[i].y1;
+        moved |= (a > b ? a - b : b - a) >= minMove;
+    }
+    auto take_rows = [this](const std::vector<Band>& from) {
+        for (size_t i = 0; i < bands.size(); ++i) {
+            bands[i].y0 = from[i].y0;
+            bands[i].y1 = from[i].y1;
+            bands[i].haloTop = from[i].haloTop;
+            bands[i].haloBot = from[i].haloBot;
+        }
+    };
+    if (!moved) {
+        take_rows(before);
+        return;
+    }
+
+    // The bands are re-seeded from the host, so it is read back under the
+    // old split first.
+    const std::vector<Band> after = bands;
+    take_rows(before);
+    sync_host(host);
+    take_rows(after);
+    if (allocate(gridW)) seed(host);
+}
+
+void CLSplitLife::step(uint32_t w, uint32_t h, uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    const size_t N = static_cast<size_t>(w) * h;
+
+    if (w != gridW || h != gridH || numSpecies != gridNS) {
+        gridW = w;
+        gridH = h;
+        gridNS = numSpecies;
+        partition(h);
+        if (!allocate(w)) return;
+        seeded = false;
+    }
+
+    if (!seeded) {
+        if (host.size() < N) {
+            std::cerr << "Warning: host grid too small to seed split engine\n";
+            return;
+        }
+        seed(host);
+        seeded = true;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    for (Band& b : bands) {
+        if (!b.rows()) continue;
+
+        cl_mem src = !flip ? b.bufA : b.bufB;
+        cl_mem dst = !flip ? b.bufB : b.bufA;
+        const cl_uint H = b.local_rows();
+
+        clSetKernelArg(b.kernel, 0, sizeof(cl_mem), &src);
+        clSetKernelArg(b.kernel, 1, sizeof(cl_mem), &dst);
+        clSetKernelArg(b.kernel, 2, sizeof(cl_uint), &w);
+        clSetKernelArg(b.kernel, 3, sizeof(cl_uint), &H);
+        clSetKernelArg(b.kernel, 4, sizeof(cl_uint), &numSpecies);
+        clSetKernelArg(b.kernel, 5, sizeof(cl_mem), nullptr);
+
+        size_t global = static_cast<size_t>(w) * H;
+        cl_event evt = nullptr;
+        clEnqueueNDRangeKernel(b.queue, b.kernel, 1, nullptr,
+            &global, nullptr, 0, nullptr, &evt);
+        if (evt) b.events.push_back(evt);
+        clFlush(b.queue);
+    }
+
+    // A halo of K rows keeps the interior exact for K generations, so the
+    // bands only wait on each other every K steps.
+    flip = !flip;
+    hostDirty = true;
+    if (++sinceExchange >= halo) {
+        exchange_edges();
+        sinceExchange = 0;
+    }
+    ++generation;
+
+    if (bands.size() > 1 && ++sinceRebalance >= rebalanceEvery) {
+        finish();
+        rebalance(h, host);
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    lastStepMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void CLSplitLife::sync_host(std::vector<unsigned char>& host)
+{
+    if (!hostDirty) return;
+
+    const size_t W = gridW;
+    host.resize(W * gridH);
+    for (Band& b : bands) {
+        if (!b.rows()) continue;
+        cl_mem cur = !flip ? b.bufA : b.bufB;
+        clEnqueueReadBuffer(b.queue, cur, CL_FALSE,
+            W * b.haloTop, W * b.rows(), host.data() + W * b.y0,
+            0, nullptr, nullptr);
+    }
+    finish();
+    hostDirty = false;
+}
+
+void CLSplitLife::shutdown()
+{
+    for (Band& b : bands) release_band(b);
+    bands.clear();
+    seeded = false;
+    hostDirty = false;
+}
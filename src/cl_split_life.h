@@ -0,0 +1,88 @@
+#pragma once
+#define CL_TARGET_OPENCL_VERSION 200
+#include <CL/cl.h>
+#include "life_engine.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Splits the grid into horizontal bands, one per OpenCL device (a GPU and
+// the CPU device by default, or every device and sub-device). Each band
+// keeps `halo` extra rows above and below. Every `halo` generations only
+// the boundary rows its neighbours need are copied between devices; the
+// whole grid comes back to the host in sync_host() or when a rebalance
+// moves the band edges. Band heights are re-balanced from the measured
+// kernel times.
+struct CLSplitLife : LifeEngine {
+    struct Band {
+        cl_context       context = nullptr;
+        cl_device_id     device = nullptr;
+        cl_command_queue queue = nullptr;
+        cl_program       program = nullptr;
+        cl_kernel        kernel = nullptr;
+        cl_mem           bufA = nullptr;
+        cl_mem           bufB = nullptr;
+        std::string      name;
+        cl_device_type   type = 0;
+        bool             subDevice = false;
+
+        uint32_t y0 = 0;
+        uint32_t y1 = 0;
+        uint32_t haloTop = 0;
+        uint32_t haloBot = 0;
+        double   share = 0.0;
+        double   lastKernelMs = 0.0;
+        double   accumMs = 0.0;
+        std::vector<cl_event> events;   // launches not yet profiled
+
+        uint32_t rows() const { return y1 - y0; }
+        uint32_t local_rows() const { return haloTop + rows() + haloBot; }
+    };
+
+    std::vector<Band> bands;
+    const char* source = nullptr;
+
+    uint32_t gridW = 0;
+    uint32_t gridH = 0;
+    uint32_t gridNS = 0;
+    uint32_t halo = 1;
+    uint32_t rebalanceEvery = 32;
+    uint32_t sinceRebalance = 0;
+    uint32_t sinceExchange = 0;
+    std::vector<unsigned char> edges;   // boundary rows in transit, grid layout
+    bool     allDevices = false;
+    uint32_t subDevices = 0;
+    bool     seeded = false;
+    bool     hostDirty = false;
+    bool     flip = false;
+    uint64_t generation = 0;
+    double   lastStepMs = 0.0;
+
+    bool init(uint32_t w, uint32_t h, uint32_t numSpecies, const char* src);
+    void step(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host) override;
+    void sync_host(std::vector<unsigned char>& host) override;
+    void shutdown() override;
+
+    void set_rebalance_interval(uint32_t n) {
+        rebalanceEvery = n ? n : 1;
+    }
+    void set_halo(uint32_t k) {
+        halo = k < 1 ? 1 : (k > 16 ? 16 : k);
+    }
+    void set_all_devices(bool on) {
+        allDevices = on;
+    }
+    void set_sub_devices(uint32_t n) {
+        subDevices = n;
+    }
+
+    bool add_device(cl_device_id dev, cl_device_type type, bool sub = false);
+    void partition(uint32_t h);
+    bool allocate(uint32_t w);
+    void seed(const std::vector<unsigned char>& host);
+    void finish();
+    void exchange_edges();
+    void exchange_halos(const std::vector<unsigned char>& rows);
+    void rebalance(uint32_t h, std::vector<unsigned char>& host);
+};
@@ -0,0 +1,357 @@
+#include "cpu_life.h"
+#include "life_rule.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_LIFE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) || !defined(CPU_LIFE_X86)
+#define CPU_TARGET(isa)
+#else
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// Row pointers address cell 0 of a padded row, so [-1] and [w] are the
+// zero border.
+typedef void (*RowFn)(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t w, uint32_t ns);
+
+static void row_tail(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t x, uint32_t w, uint32_t ns)
+{
+    for (; x < w; ++x) {
+        const unsigned char* u = up + x;
+        const unsigned char* m = mid + x;
+        const unsigned char* d = dn + x;
+        const unsigned char nb[8] = { u[-1], u[0], u[1], m[-1], m[1], d[-1], d[0], d[1] };
+        out[x] = life_rule(m[0], nb, ns);
+    }
+}
+
+static void row_scalar(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t w, uint32_t ns)
+{
+    row_tail(up, mid, dn, out, 0, w, ns);
+}
+
+#ifdef CPU_LIFE_X86
+// Each vector kernel walks the species from ns down to 1 and overwrites the
+// result wherever species s survives or is born, so the lowest species with
+// three neighbors wins a birth exactly as in RULE().
+CPU_TARGET("sse4.1")
+static void row_sse41(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t w, uint32_t ns)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i three = _mm_set1_epi8(3);
+
+    uint32_t x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i nb[8];
+        nb[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x - 1));
+        nb[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+        nb[2] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x + 1));
+        nb[3] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x - 1));
+        nb[4] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x + 1));
+        nb[5] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dn + x - 1));
+        nb[6] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dn + x));
+        nb[7] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dn + x + 1));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x));
+        const __m128i dead = _mm_cmpeq_epi8(c, zero);
+
+        __m128i res = zero;
+        for (uint32_t s = ns; s >= 1; --s) {
+            const __m128i sv = _mm_set1_epi8(static_cast<char>(s));
+            __m128i cnt = zero;
+            for (int k = 0; k < 8; ++k)
+                cnt = _mm_sub_epi8(cnt, _mm_cmpeq_epi8(nb[k], sv));
+
+            const __m128i is3 = _mm_cmpeq_epi8(cnt, three);
+            const __m128i keep = _mm_and_si128(_mm_cmpeq_epi8(c, sv),
+                _mm_or_si128(is3, _mm_cmpeq_epi8(cnt, two)));
+            const __m128i born = _mm_and_si128(dead, is3);
+            res = _mm_blendv_epi8(res, sv, _mm_or_si128(keep, born));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), res);
+    }
+    row_tail(up, mid, dn, out, x, w, ns);
+}
+
+CPU_TARGET("avx2")
+static void row_avx2(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t w, uint32_t ns)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i three = _mm256_set1_epi8(3);
+
+    uint32_t x = 0;
+    for (; x + 32 <= w; x += 32) {
+        __m256i nb[8];
+        nb[0] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x - 1));
+        nb[1] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+        nb[2] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x + 1));
+        nb[3] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x - 1));
+        nb[4] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x + 1));
+        nb[5] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dn + x - 1));
+        nb[6] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dn + x));
+        nb[7] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dn + x + 1));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x));
+        const __m256i dead = _mm256_cmpeq_epi8(c, zero);
+
+        __m256i res = zero;
+        for (uint32_t s = ns; s >= 1; --s) {
+            const __m256i sv = _mm256_set1_epi8(static_cast<char>(s));
+            __m256i cnt = zero;
+            for (int k = 0; k < 8; ++k)
+                cnt = _mm256_sub_epi8(cnt, _mm256_cmpeq_epi8(nb[k], sv));
+
+            const __m256i is3 = _mm256_cmpeq_epi8(cnt, three);
+            const __m256i keep = _mm256_and_si256(_mm256_cmpeq_epi8(c, sv),
+                _mm256_or_si256(is3, _mm256_cmpeq_epi8(cnt, two)));
+            const __m256i born = _mm256_and_si256(dead, is3);
+            res = _mm256_blendv_epi8(res, sv, _mm256_or_si256(keep, born));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), res);
+    }
+    row_tail(up, mid, dn, out, x, w, ns);
+}
+
+CPU_TARGET("avx512f,avx512bw")
+static void row_avx512(const unsigned char* up, const unsigned char* mid,
+    const unsigned char* dn, unsigned char* out, uint32_t w, uint32_t ns)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i two = _mm512_set1_epi8(2);
+    const __m512i three = _mm512_set1_epi8(3);
+
+    uint32_t x = 0;
+    for (; x + 64 <= w; x += 64) {
+        __m512i nb[8];
+        nb[0] = _mm512_loadu_si512(up + x - 1);
+        nb[1] = _mm512_loadu_si512(up + x);
+        nb[2] = _mm512_loadu_si512(up + x + 1);
+        nb[3] = _mm512_loadu_si512(mid + x - 1);
+        nb[4] = _mm512_loadu_si512(mid + x + 1);
+        nb[5] = _mm512_loadu_si512(dn + x - 1);
+        nb[6] = _mm512_loadu_si512(dn + x);
+        nb[7] = _mm512_loadu_si512(dn + x + 1);
+        const __m512i c = _mm512_loadu_si512(mid + x);
+        const __mmask64 dead = _mm512_cmpeq_epi8_mask(c, zero);
+
+        __m512i res = zero;
+        for (uint32_t s = ns; s >= 1; --s) {
+            const __m512i sv = _mm512_set1_epi8(static_cast<char>(s));
+            __m512i cnt = zero;
+            for (int k = 0; k < 8; ++k)
+                cnt = _mm512_mask_add_epi8(cnt, _mm512_cmpeq_epi8_mask(nb[k], sv), cnt, one);
+
+            const __mmask64 is3 = _mm512_cmpeq_epi8_mask(cnt, three);
+            const __mmask64 keep = _mm512_cmpeq_epi8_mask(c, sv)
+                & (is3 | _mm512_cmpeq_epi8_mask(cnt, two));
+            res = _mm512_mask_mov_epi8(res, keep | (dead & is3), sv);
+        }
+        _mm512_storeu_si512(out + x, res);
+    }
+    row_tail(up, mid, dn, out, x, w, ns);
+}
+
+static void cpuid(int leaf, int sub, int regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, sub);
+#else
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, sub, a, b, c, d);
+    regs[0] = static_cast<int>(a);
+    regs[1] = static_cast<int>(b);
+    regs[2] = static_cast<int>(c);
+    regs[3] = static_cast<int>(d);
+#endif
+}
+
+static uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo = 0, hi = 0;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+CpuIsa CpuLife::detect_isa()
+{
+#ifdef CPU_LIFE_X86
+    int r[4] = { 0, 0, 0, 0 };
+    cpuid(0, 0, r);
+    const int maxLeaf = r[0];
+    if (maxLeaf < 1) return CpuIsa::Scalar;
+
+    cpuid(1, 0, r);
+    const bool sse41 = (r[2] >> 19) & 1;
+    const bool osxsave = (r[2] >> 27) & 1;
+    const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    const bool ymmOS = (xcr0 & 0x6) == 0x6;
+    const bool zmmOS = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false, avx512bw = false;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, r);
+        avx2 = ymmOS && ((r[1] >> 5) & 1);
+        avx512bw = zmmOS && ((r[1] >> 16) & 1) && ((r[1] >> 30) & 1);
+    }
+
+    if (avx512bw) return CpuIsa::AVX512BW;
+    if (avx2)     return CpuIsa::AVX2;
+    if (sse41)    return CpuIsa::SSE41;
+#endif
+    return CpuIsa::Scalar;
+}
+
+const char* CpuLife::isa_name(CpuIsa i)
+{
+    switch (i) {
+    case CpuIsa::AVX512BW: return "AVX-512BW";
+    case CpuIsa::AVX2:     return "AVX2";
+    case CpuIsa::SSE41:    return "SSE4.1";
+    default:               return "scalar";
+    }
+}
+
+static RowFn row_fn(CpuIsa isa)
+{
+#ifdef CPU_LIFE_X86
+    switch (isa) {
+    case CpuIsa::AVX512BW: return row_avx512;
+    case CpuIsa::AVX2:     return row_avx2;
+    case CpuIsa::SSE41:    return row_sse41;
+    default:               break;
+    }
+#else
+    (void)isa;
+#endif
+    return row_scalar;
+}
+
+bool CpuLife::init(uint32_t w, uint32_t h, uint32_t numSpecies, unsigned threads)
+{
+    (void)numSpecies;
+
+    pool.start(threads);
+    isa = detect_isa();
+
+    gridW = w;
+    gridH = h;
+    cur = 0;
+    seeded = false;
+    scalarOnly = false;
+    generation = 0;
+    lastStepMs = 0.0;
+    return true;
+}
+
+void CpuLife::set_isa(CpuIsa i)
+{
+    // Never go wider than the host supports.
+    const CpuIsa best = detect_isa();
+    isa = (static_cast<int>(i) > static_cast<int>(best)) ? best : i;
+}
+
+void CpuLife::seed(uint32_t w, uint32_t h, uint32_t numSpecies,
+    const std::vector<unsigned char>& host)
+{
+    gridW = w;
+    gridH = h;
+    stride = w + 2;
+
+    const size_t padded = static_cast<size_t>(stride) * (h + 2);
+    cells[0].assign(padded, 0);
+    cells[1].assign(padded, 0);
+    cur = 0;
+
+    const size_t N = static_cast<size_t>(w) * h;
+    if (host.size() < N) {
+        std::cerr << "Warning: host grid too small to seed CPU engine\n";
+        return;
+    }
+
+    // The vector kernels only track species 1..numSpecies; anything else
+    // in the seed is handled by the scalar rule.
+    scalarOnly = false;
+    for (uint32_t y = 0; y < h; ++y) {
+        const unsigned char* row = host.data() + static_cast<size_t>(y) * w;
+        std::memcpy(cells[0].data() + static_cast<size_t>(y + 1) * stride + 1, row, w);
+        for (uint32_t x = 0; x < w && !scalarOnly; ++x)
+            scalarOnly = row[x] > numSpecies;
+    }
+    if (scalarOnly) {
+        std::cerr << "Warning: seed has species above " << numSpecies
+            << ", CPU engine using scalar kernel\n";
+    }
+}
+
+void CpuLife::step(uint32_t w, uint32_t h, uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    if (!seeded || w != gridW || h != gridH) {
+        seed(w, h, numSpecies, host);
+        seeded = true;
+        hostDirty = false;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    const unsigned char* src = cells[cur].data();
+    unsigned char* dst = cells[cur ^ 1].data();
+    const RowFn fn = scalarOnly ? row_scalar : row_fn(isa);
+    const size_t s = stride;
+
+    pool.parallel_for(h, [&](size_t b, size_t e) {
+        for (size_t y = b; y < e; ++y) {
+            const unsigned char* mid = src + (y + 1) * s + 1;
+            fn(mid - s, mid, mid + s, dst + (y + 1) * s + 1, w, numSpecies);
+        }
+    });
+    cur ^= 1;
+    hostDirty = true;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    lastStepMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    ++generation;
+}
+
+void CpuLife::sync_host(std::vector<unsigned char>& host)
+{
+    if (!hostDirty) return;
+
+    const unsigned char* src = cells[cur].data();
+    host.resize(static_cast<size_t>(gridW) * gridH);
+    for (uint32_t y = 0; y < gridH; ++y) {
+        std::memcpy(host.data() + static_cast<size_t>(y) * gridW,
+            src + static_cast<size_t>(y + 1) * stride + 1, gridW);
+    }
+    hostDirty = false;
+}
+
+void CpuLife::shutdown()
+{
+    pool.stop();
+    cells[0].clear();
+    cells[1].clear();
+    seeded = false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "life_engine.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <vector>
+
+enum class CpuIsa {
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512BW
+};
+
+// Native engine with the same contract and output as life_step: dead
+// boundary, multi-species rule from life_rule.h. Rows are split into bands
+// over a ThreadPool and each band runs the widest SIMD kernel CPUID allows.
+// The grids are ping-ponged with a one-cell zero border so the kernels
+// never branch on the edge.
+struct CpuLife : LifeEngine {
+    std::vector<unsigned char> cells[2];
+    ThreadPool pool;
+
+    CpuIsa   isa = CpuIsa::Scalar;
+    int      cur = 0;
+    bool     seeded = false;
+    bool     hostDirty = false;
+    bool     scalarOnly = false;
+    uint32_t gridW = 0;
+    uint32_t gridH = 0;
+    uint32_t stride = 0;
+    uint64_t generation = 0;
+    double   lastStepMs = 0.0;
+
+    bool init(uint32_t w, uint32_t h, uint32_t numSpecies, unsigned threads = 0);
+    void step(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host) override;
+    void sync_host(std::vector<unsigned char>& host) override;
+    void shutdown() override;
+
+    void set_isa(CpuIsa i);
+    void seed(uint32_t w, uint32_t h, uint32_t numSpecies,
+        const std::vector<unsigned char>& host);
+
+    static CpuIsa detect_isa();
+    static const char* isa_name(CpuIsa i);
+};
@@ -0,0 +1,540 @@
+#include "hashlife.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+static const uint8_t FREE_LEVEL = 0xFF;
+
+static size_t node_hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint64_t h = a;
+    h = h * 0x100000001B3ull + b;
+    h = h * 0x100000001B3ull + c;
+    h = h * 0x100000001B3ull + d;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return static_cast<size_t>(h);
+}
+
+static bool cell_at(const std::vector<HashLife::Node>& nodes, uint32_t n,
+    uint32_t x, uint32_t y)
+{
+    while (nodes[n].level > 0) {
+        const HashLife::Node& c = nodes[n];
+        uint32_t half = 1u << (c.level - 1);
+        bool right = x >= half;
+        bool down = y >= half;
+        n = down ? (right ? c.se : c.sw) : (right ? c.ne : c.nw);
+        if (right) x -= half;
+        if (down)  y -= half;
+    }
+    return n == 1;
+}
+
+bool HashLife::init(uint32_t w, uint32_t h, uint32_t numSpecies)
+{
+    (void)w;
+    (void)h;
+    if (numSpecies != 1) {
+        std::cerr << "Warning: HashLife runs B3/S23; all species are treated as one\n";
+    }
+
+    nodes.clear();
+    freeList.clear();
+    empties.clear();
+    pinned.clear();
+
+    nodes.resize(2);
+    nodes[0].level = 0;
+    nodes[0].pop = 0;
+    nodes[1].level = 0;
+    nodes[1].pop = 1;
+    empties.push_back(0);
+
+    liveNodes = 0;
+    rehash(1u << 16);
+    if (maxNodes == 0) set_memory_cap_mb(256);
+
+    root = empty(3);
+    resultLog2 = NONE;
+    seeded = false;
+    generation = 0;
+    population = 0;
+    gcRuns = 0;
+    gcLive = 0;
+    lastStepMs = 0.0;
+    return true;
+}
+
+void HashLife::rehash(size_t count)
+{
+    buckets.assign(count, NONE);
+    for (uint32_t i = 2; i < nodes.size(); ++i) {
+        Node& n = nodes[i];
+        if (n.level == FREE_LEVEL) continue;
+        size_t b = node_hash(n.nw, n.ne, n.sw, n.se) & (count - 1);
+        n.next = buckets[b];
+        buckets[b] = i;
+    }
+}
+
+uint32_t HashLife::join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+    size_t b = node_hash(nw, ne, sw, se) & (buckets.size() - 1);
+    for (uint32_t i = buckets[b]; i != NONE; i = nodes[i].next) {
+        const Node& n = nodes[i];
+        if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se) return i;
+    }
+
+    uint32_t id;
+    if (!freeList.empty()) {
+        id = freeList.back();
+        freeList.pop_back();
+    }
+    else {
+        id = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& n = nodes[id];
+    n.nw = nw;
+    n.ne = ne;
+    n.sw = sw;
+    n.se = se;
+    n.res = NONE;
+    n.mark = 0;
+    n.level = static_cast<uint8_t>(nodes[nw].level + 1);
+    n.pop = nodes[nw].pop + nodes[ne].pop + nodes[sw].pop + nodes[se].pop;
+    n.next = buckets[b];
+    buckets[b] = id;
+
+    if (++liveNodes > buckets.size()) rehash(buckets.size() * 2);
+    return id;
+}
+
+uint32_t HashLife::empty(uint32_t level)
+{
+    while (empties.size() <= level) {
+        uint32_t e = empties.back();
+        empties.push_back(join(e, e, e, e));
+    }
+    return empties[level];
+}
+
+uint32_t HashLife::expand(uint32_t n)
+{
+    const Node c = nodes[n];
+    uint32_t e = empty(c.level - 1);
+    uint32_t nw = join(e, e, e, c.nw);
+    uint32_t ne = join(e, e, c.ne, e);
+    uint32_t sw = join(e, c.sw, e, e);
+    uint32_t se = join(c.se, e, e, e);
+    return join(nw, ne, sw, se);
+}
+
+uint32_t HashLife::centre(uint32_t n)
+{
+    const Node c = nodes[n];
+    return join(nodes[c.nw].se, nodes[c.ne].sw, nodes[c.sw].ne, nodes[c.se].nw);
+}
+
+uint32_t HashLife::base4(uint32_t n)
+{
+    int g[4][4];
+    for (uint32_t y = 0; y < 4; ++y)
+        for (uint32_t x = 0; x < 4; ++x)
+            g[y][x] = cell_at(nodes, n, x, y) ? 1 : 0;
+
+    uint32_t out[2][2];
+    for (int y = 1; y <= 2; ++y) {
+        for (int x = 1; x <= 2; ++x) {
+            int c = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx)
+                    if (dx || dy) c += g[y + dy][x + dx];
+            out[y - 1][x - 1] = (c == 3 || (c == 2 && g[y][x])) ? 1u : 0u;
+        }
+    }
+    return join(out[0][0], out[0][1], out[1][0], out[1][1]);
+}
+
+uint32_t HashLife::successor(uint32_t n)
+{
+    if (nodes[n].res != NONE) return nodes[n].res;
+
+    // A big superspeed step can outgrow the memory cap on its own, so the
+    // collector may run here. Every node an unfinished call still needs is
+    // pinned for it.
+    const size_t pinBase = pinned.size();
+    pinned.push_back(n);
+    maybe_collect();
+
+    const Node c = nodes[n];
+    uint32_t res;
+
+    if (c.pop == 0) {
+        res = empty(c.level - 1);
+    }
+    else if (c.level == 2) {
+        res = base4(n);
+    }
+    else {
+        const Node nw = nodes[c.nw], ne = nodes[c.ne], sw = nodes[c.sw], se = nodes[c.se];
+
+        uint32_t n00 = c.nw;
+        uint32_t n01 = join(nw.ne, ne.nw, nw.se, ne.sw);
+        uint32_t n02 = c.ne;
+        uint32_t n10 = join(nw.sw, nw.se, sw.nw, sw.ne);
+        uint32_t n11 = join(nw.se, ne.sw, sw.ne, se.nw);
+        uint32_t n12 = join(ne.sw, ne.se, se.nw, se.ne);
+        uint32_t n20 = c.sw;
+        uint32_t n21 = join(sw.ne, se.nw, sw.se, se.sw);
+        uint32_t n22 = c.se;
+        pinned.insert(pinned.end(), { n01, n10, n11, n12, n21 });
+
+        const bool full = resultLog2 + 2 >= c.level;
+        auto first = [&](uint32_t m) {
+            uint32_t r = full ? successor(m) : centre(m);
+            pinned.push_back(r);
+            return r;
+        };
+
+        uint32_t r00 = first(n00), r01 = first(n01), r02 = first(n02);
+        uint32_t r10 = first(n10), r11 = first(n11), r12 = first(n12);
+        uint32_t r20 = first(n20), r21 = first(n21), r22 = first(n22);
+
+        uint32_t a = successor(join(r00, r01, r10, r11));
+        pinned.push_back(a);
+        uint32_t b = successor(join(r01, r02, r11, r12));
+        pinned.push_back(b);
+        uint32_t d = successor(join(r10, r11, r20, r21));
+        pinned.push_back(d);
+        uint32_t e = successor(join(r11, r12, r21, r22));
+        res = join(a, b, d, e);
+    }
+
+    pinned.resize(pinBase);
+    nodes[n].res = res;
+    return res;
+}
+
+void HashLife::advance()
+{
+    auto inCentre = [this](uint32_t n) {
+        return nodes[centre(centre(n))].pop == nodes[n].pop;
+    };
+
+    uint32_t j;
+    if (superspeed) {
+        while (nodes[root].level < 4 || !inCentre(root)) root = expand(root);
+        j = nodes[root].level - 3u;
+    }
+    else {
+        j = stepLog2;
+        while (nodes[root].level < j + 3 || !inCentre(root)) root = expand(root);
+    }
+
+    // A node of level L steps min(2^j, 2^(L-2)) generations, so only the
+    // results of nodes past the smaller of the old and new j change.
+    if (j != resultLog2) {
+        const uint32_t stale = (resultLog2 == NONE ? j : std::min(j, resultLog2)) + 3;
+        for (Node& n : nodes) {
+            if (n.level != FREE_LEVEL && n.level >= stale) n.res = NONE;
+        }
+        resultLog2 = j;
+    }
+
+    root = successor(root);
+    generation += 1ull << j;
+    population = nodes[root].pop;
+}
+
+void HashLife::collect()
+{
+    std::vector<uint32_t> stack(empties.begin(), empties.end());
+    stack.insert(stack.end(), pinned.begin(), pinned.end());
+    stack.push_back(root);
+    while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        Node& n = nodes[i];
+        if (n.mark) continue;
+        n.mark = 1;
+        if (n.level > 0) {
+            stack.push_back(n.nw);
+            stack.push_back(n.ne);
+            stack.push_back(n.sw);
+            stack.push_back(n.se);
+        }
+    }
+
+    for (uint32_t i = 2; i < nodes.size(); ++i) {
+        Node& n = nodes[i];
+        if (n.level != FREE_LEVEL && n.mark && n.res != NONE && !nodes[n.res].mark)
+            n.res = NONE;
+    }
+
+    for (uint32_t i = 2; i < nodes.size(); ++i) {
+        Node& n = nodes[i];
+        if (n.level == FREE_LEVEL) continue;
+        if (!n.mark) {
+            n.level = FREE_LEVEL;
+            n.res = NONE;
+            freeList.push_back(i);
+            --liveNodes;
+        }
+    }
+
+    for (Node& n : nodes) n.mark = 0;
+    rehash(buckets.size());
+    ++gcRuns;
+}
+
+// Collects once the pool passes the cap. When the live set alone is over
+// it, the next run waits until the pool has doubled so it does not thrash.
+void HashLife::maybe_collect()
+{
+    if (liveNodes <= maxNodes || liveNodes <= 2 * gcLive) return;
+    collect();
+    gcLive = liveNodes;
+}
+
+uint32_t HashLife::build(const std::vector<unsigned char>& grid, uint32_t w, uint32_t h,
+    uint32_t level, int64_t x0, int64_t y0)
+{
+    const int64_t vx0 = -static_cast<int64_t>(w / 2);
+    const int64_t vy0 = -static_cast<int64_t>(h / 2);
+    const int64_t size = int64_t(1) << level;
+
+    if (x0 >= vx0 + w || y0 >= vy0 + h || x0 + size <= vx0 || y0 + size <= vy0)
+        return empty(level);
+
+    if (level == 0) {
+        size_t id = static_cast<size_t>(y0 - vy0) * w + static_cast<size_t>(x0 - vx0);
+        return (id < grid.size() && grid[id]) ? 1u : 0u;
+    }
+
+    const int64_t half = size / 2;
+    uint32_t nw = build(grid, w, h, level - 1, x0, y0);
+    uint32_t ne = build(grid, w, h, level - 1, x0 + half, y0);
+    uint32_t sw = build(grid, w, h, level - 1, x0, y0 + half);
+    uint32_t se = build(grid, w, h, level - 1, x0 + half, y0 + half);
+    return join(nw, ne, sw, se);
+}
+
+void HashLife::rasterize(uint32_t n, int64_t x0, int64_t y0,
+    uint32_t w, uint32_t h, std::vector<unsigned char>& host) const
+{
+    const Node& c = nodes[n];
+    if (c.pop == 0) return;
+
+    if (c.level < 62) {
+        const int64_t vx0 = -static_cast<int64_t>(w / 2);
+        const int64_t vy0 = -static_cast<int64_t>(h / 2);
+        const int64_t size = int64_t(1) << c.level;
+        if (x0 >= vx0 + w || y0 >= vy0 + h || x0 + size <= vx0 || y0 + size <= vy0)
+            return;
+
+        if (c.level == 0) {
+            host[static_cast<size_t>(y0 - vy0) * w + static_cast<size_t>(x0 - vx0)] = 1;
+            return;
+        }
+    }
+
+    const int64_t half = int64_t(1) << (c.level - 1);
+    rasterize(c.nw, x0, y0, w, h, host);
+    rasterize(c.ne, x0 + half, y0, w, h, host);
+    rasterize(c.sw, x0, y0 + half, w, h, host);
+    rasterize(c.se, x0 + half, y0 + half, w, h, host);
+}
+
+void HashLife::step(uint32_t w, uint32_t h, uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    (void)numSpecies;
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    if (!seeded) {
+        uint32_t level = 3;
+        while ((int64_t(1) << (level - 1)) < static_cast<int64_t>(w > h ? w : h)) ++level;
+        const int64_t half = int64_t(1) << (level - 1);
+        root = build(host, w, h, level, -half, -half);
+        seeded = true;
+    }
+
+    maybe_collect();
+
+    advance();
+
+    const size_t N = static_cast<size_t>(w) * h;
+    host.assign(N, 0);
+    const uint32_t level = nodes[root].level;
+    const int64_t half = level < 63 ? (int64_t(1) << (level - 1)) : 0;
+    rasterize(root, -half, -half, w, h, host);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    lastStepMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+bool HashLife::load_mc(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open macrocell file " << path << "\n";
+        return false;
+    }
+
+    std::vector<uint32_t> ids(1, 0);
+    std::vector<uint8_t> levels(1, 0);
+    uint64_t gen = 0;
+    std::string line;
+
+    std::function<uint32_t(const uint8_t*, uint32_t, uint32_t, uint32_t)> leaf =
+        [&](const uint8_t* cells, uint32_t level, uint32_t x, uint32_t y) -> uint32_t {
+        if (level == 0) return cells[y * 8 + x];
+        uint32_t half = 1u << (level - 1);
+        return join(leaf(cells, level - 1, x, y),
+                    leaf(cells, level - 1, x + half, y),
+                    leaf(cells, level - 1, x, y + half),
+                    leaf(cells, level - 1, x + half, y + half));
+    };
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '[') continue;
+
+        if (line[0] == '#') {
+            if (line.compare(0, 2, "#G") == 0) {
+                gen = std::strtoull(line.c_str() + 2, nullptr, 10);
+            }
+            else if (line.compare(0, 2, "#R") == 0 && line.find("B3/S23") == std::string::npos) {
+                std::cerr << "Warning: macrocell rule is not B3/S23, loading as B3/S23\n";
+            }
+            continue;
+        }
+
+        if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+            uint8_t cells[64] = {};
+            uint32_t x = 0, y = 0;
+            for (char ch : line) {
+                if (ch == '$') { ++y; x = 0; }
+                else if (ch == '*') { if (x < 8 && y < 8) cells[y * 8 + x] = 1; ++x; }
+                else if (ch == '.') { ++x; }
+            }
+            ids.push_back(leaf(cells, 3, 0, 0));
+            levels.push_back(3);
+            continue;
+        }
+
+        std::istringstream ss(line);
+        uint32_t level = 0, c[4] = {};
+        if (!(ss >> level >> c[0] >> c[1] >> c[2] >> c[3]) || level < 4 || level > 62) {
+            std::cerr << "Malformed macrocell line: " << line << "\n";
+            return false;
+        }
+
+        uint32_t kids[4];
+        for (int i = 0; i < 4; ++i) {
+            if (c[i] >= ids.size()) {
+                std::cerr << "Macrocell references undefined node " << c[i] << "\n";
+                return false;
+            }
+            if (c[i] && levels[c[i]] != level - 1) {
+                std::cerr << "Macrocell node " << c[i] << " has level " << unsigned(levels[c[i]])
+                          << ", expected " << (level - 1) << "\n";
+                return false;
+            }
+            kids[i] = c[i] ? ids[c[i]] : empty(level - 1);
+        }
+        ids.push_back(join(kids[0], kids[1], kids[2], kids[3]));
+        levels.push_back(static_cast<uint8_t>(level));
+    }
+
+    if (ids.size() < 2) {
+        std::cerr << "Macrocell file " << path << " has no nodes\n";
+        return false;
+    }
+
+    root = ids.back();
+    generation = gen;
+    population = nodes[root].pop;
+    seeded = true;
+    return true;
+}
+
+bool HashLife::save_mc(const std::string& path)
+{
+    while (nodes[root].level < 3) root = expand(root);
+
+    std::unordered_map<uint32_t, uint32_t> ids;
+    std::vector<std::string> lines;
+
+    std::function<uint32_t(uint32_t)> emit = [&](uint32_t n) -> uint32_t {
+        if (nodes[n].pop == 0) return 0;
+        auto it = ids.find(n);
+        if (it != ids.end()) return it->second;
+
+        const Node c = nodes[n];
+        std::string out;
+        if (c.level == 3) {
+            std::string rows;
+            for (uint32_t y = 0; y < 8; ++y) {
+                std::string row;
+                for (uint32_t x = 0; x < 8; ++x)
+                    row += cell_at(nodes, n, x, y) ? '*' : '.';
+                row.erase(row.find_last_not_of('.') + 1);
+                rows += row + '$';
+                if (!row.empty()) out = rows;
+            }
+        }
+        else {
+            uint32_t a = emit(c.nw), b = emit(c.ne), d = emit(c.sw), e = emit(c.se);
+            out = std::to_string(c.level) + " " + std::to_string(a) + " " + std::to_string(b)
+                + " " + std::to_string(d) + " " + std::to_string(e);
+        }
+
+        lines.push_back(out);
+        uint32_t id = static_cast<uint32_t>(lines.size());
+        ids[n] = id;
+        return id;
+    };
+
+    if (nodes[root].pop == 0) {
+        lines.push_back(std::to_string(nodes[root].level) + " 0 0 0 0");
+        if (nodes[root].level == 3) lines.back() = "$";
+    }
+    else {
+        emit(root);
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write macrocell file " << path << "\n";
+        return false;
+    }
+
+    out << "[M2] (Comp426Project)\n#R B3/S23\n#G " << generation << "\n";
+    for (const std::string& l : lines) out << l << "\n";
+    return static_cast<bool>(out);
+}
+
+void HashLife::shutdown()
+{
+    nodes.clear();
+    nodes.shrink_to_fit();
+    buckets.clear();
+    buckets.shrink_to_fit();
+    freeList.clear();
+    empties.clear();
+    pinned.clear();
+    liveNodes = 0;
+    root = 0;
+    seeded = false;
+}
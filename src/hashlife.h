@@ -0,0 +1,71 @@
+#pragma once
+#include "life_engine.h"
+#include <vector>
+#include <cstdint>
+#include <string>
+
+// Hash-consed quadtree engine for single-species B3/S23. The universe is
+// unbounded; step() rasterizes a w x h viewport centred on the origin.
+struct HashLife : LifeEngine {
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    struct Node {
+        uint32_t nw = 0, ne = 0, sw = 0, se = 0;
+        uint32_t next = NONE;
+        uint32_t res = NONE;
+        uint64_t pop = 0;
+        uint8_t  level = 0;
+        uint8_t  mark = 0;
+    };
+
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> buckets;
+    std::vector<uint32_t> freeList;
+    std::vector<uint32_t> empties;
+    std::vector<uint32_t> pinned;     // still in use by an unfinished successor()
+    size_t   liveNodes = 0;
+    size_t   maxNodes = 0;
+    uint32_t root = 0;
+    uint32_t stepLog2 = 0;
+    uint32_t resultLog2 = NONE;
+    bool     superspeed = false;
+    bool     seeded = false;
+    uint64_t generation = 0;
+    uint64_t population = 0;
+    size_t   gcRuns = 0;
+    size_t   gcLive = 0;
+    double   lastStepMs = 0.0;
+
+    bool init(uint32_t w, uint32_t h, uint32_t numSpecies);
+    void step(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host) override;
+    void shutdown() override;
+
+    void set_step_log2(uint32_t k) {
+        stepLog2 = k > 60 ? 60 : k;
+    }
+    void set_superspeed(bool on) {
+        superspeed = on;
+    }
+    void set_memory_cap_mb(size_t mb) {
+        maxNodes = mb * 1024 * 1024 / sizeof(Node);
+    }
+
+    bool load_mc(const std::string& path);
+    bool save_mc(const std::string& path);
+
+    uint32_t join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+    uint32_t empty(uint32_t level);
+    uint32_t expand(uint32_t n);
+    uint32_t centre(uint32_t n);
+    uint32_t successor(uint32_t n);
+    uint32_t base4(uint32_t n);
+    uint32_t build(const std::vector<unsigned char>& grid, uint32_t w, uint32_t h,
+        uint32_t level, int64_t x0, int64_t y0);
+    void     rasterize(uint32_t n, int64_t x0, int64_t y0,
+        uint32_t w, uint32_t h, std::vector<unsigned char>& host) const;
+    void     advance();
+    void     collect();
+    void     maybe_collect();
+    void     rehash(size_t count);
+};
@@ -4,78 +4,502 @@ static const char* LIFE_KERNEL_SRC = R"CLC(
 typedef unsigned char U8;
 typedef unsigned int  U32;
 
+#ifndef LIFE_WRAP
+#define LIFE_WRAP 0
+#endif
+#ifndef LIFE_BIRTH
+#define LIFE_BIRTH 0x8u
+#endif
+#ifndef LIFE_SURVIVE
+#define LIFE_SURVIVE 0xCu
+#endif
+
+#ifdef LIFE_W
+#define SPEC_W(a) ((U32)LIFE_W)
+#else
+#define SPEC_W(a) (a)
+#endif
+#ifdef LIFE_H
+#define SPEC_H(a) ((U32)LIFE_H)
+#else
+#define SPEC_H(a) (a)
+#endif
+#ifdef LIFE_NS
+#define SPEC_NS(a) ((U32)LIFE_NS)
+#else
+#define SPEC_NS(a) (a)
+#endif
+
 inline int IB(int x,int y,U32 w,U32 h) {
     return (x>=0 && y>=0 && (U32)x<w && (U32)y<h);
 }
 
-inline int CN(__global const U8* g,int x,int y,U32 w,U32 h,U8 s) {
-    int c=0;
-    for(int dy=-1;dy<=1;++dy){
-        for(int dx=-1;dx<=1;++dx){
-            if(dx==0 && dy==0) continue;
-            int nx=x+dx, ny=y+dy;
-            if(IB(nx,ny,w,h)){
-                U32 id=(U32)ny*w+(U32)nx;
-                if(g[id]==s) ++c;
-            }
-        }
+#if LIFE_WRAP
+#define INSIDE(x,y,w,h) 1
+inline int WRAP(int v,U32 n) {
+    int m = v % (int)n;
+    return m < 0 ? m + (int)n : m;
+}
+inline U8 AT(__global const U8* g,int x,int y,U32 w,U32 h) {
+    return g[(U32)WRAP(y,h)*w+(U32)WRAP(x,w)];
+}
+#else
+#define INSIDE(x,y,w,h) IB(x,y,w,h)
+inline U8 AT(__global const U8* g,int x,int y,U32 w,U32 h) {
+    return IB(x,y,w,h) ? g[(U32)y*w+(U32)x] : (U8)0;
+}
+#endif
+
+inline U8 RULE(U8 v,const U8 nb[8],U32 ns) {
+    if(v!=0){
+        int c=0;
+        for(int i=0;i<8;++i) c+=(nb[i]==v);
+        return ((LIFE_SURVIVE >> c) & 1u) ? v : (U8)0;
+    }
+    U8 pick=0;
+    for(int i=0;i<8;++i){
+        U8 s=nb[i];
+        if(s==0 || (U32)s>ns || (pick!=0 && s>=pick)) continue;
+        int c=0;
+        for(int j=0;j<8;++j) c+=(nb[j]==s);
+        if((LIFE_BIRTH >> c) & 1u) pick=s;
     }
-    return c;
+    return pick;
+}
+
+// Births and deaths of one launch per species: stats[s] and
+// stats[STATS_BINS + s]. Each work-group histograms into local memory
+// (births in acc[0, NS], deaths in acc[NS + 1, 2 NS + 1], then the two hash
+// lanes) and merges every non-zero slot with one global atomic. Tiles the
+// active kernel skips do not change, so they add nothing. A null `stats`
+// turns the count off. Every work-item of the group must reach STATS_BEGIN,
+// which needs a barrier before the first STATS_CELL, and STATS_END.
+#define STATS_BINS  256
+#define STATS_LOCAL (2 * STATS_BINS + 2)
+
+// The grid hash is two 32-bit lanes, each the wrapping sum of HASH_MIX over
+// non-zero cells (words in the bit-plane kernel), so a launch only reports
+// the change at stats[2 * STATS_BINS + 1] and [+ 2]. Keep in sync with
+// grid_hash() in cl_life.cpp.
+inline U32 HASH_MIX(U32 x) {
+    x ^= x >> 16; x *= 0x7FEB352Du;
+    x ^= x >> 15; x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
 }
+inline U32 HASH_A(U32 id, U32 v) { return v ? HASH_MIX(id * 0x9E3779B1u + v * 0x85EBCA77u) : 0u; }
+inline U32 HASH_B(U32 id, U32 v) { return v ? HASH_MIX(id * 0xC2B2AE35u + v * 0x27D4EB2Fu + 0x165667B1u) : 0u; }
 
-__kernel void life_step(__global const U8* A, __global U8* B, const U32 W, const U32 H, const U32 NS) {
+inline void STATS_HASH(__local int* acc, U32 NS, U32 id, U32 in, U32 out) {
+    volatile __local U32* h = (volatile __local U32*)(acc + 2 * (NS + 1));
+    atomic_add(h,     HASH_A(id, out) - HASH_A(id, in));
+    atomic_add(h + 1, HASH_B(id, out) - HASH_B(id, in));
+}
+
+inline void STATS_BEGIN(__local int* acc, U32 NS) {
+    int lid = (int)(get_local_id(1) * get_local_size(0) + get_local_id(0));
+    int lsz = (int)(get_local_size(0) * get_local_size(1));
+    for (int i = lid; i < 2 * (int)(NS + 2); i += lsz) acc[i] = 0;
+}
+
+inline void STATS_CELL(__local int* acc, U32 NS, U32 id, U8 in, U8 out) {
+    if (in == out) return;
+    if (in && (U32)in <= NS) atomic_inc(acc + NS + 1 + in);
+    if (out) atomic_inc(acc + out);
+    STATS_HASH(acc, NS, id, in, out);
+}
+
+inline void STATS_END(__global int* stats, __local int* acc, U32 NS) {
+    barrier(CLK_LOCAL_MEM_FENCE);
+    int lid = (int)(get_local_id(1) * get_local_size(0) + get_local_id(0));
+    int lsz = (int)(get_local_size(0) * get_local_size(1));
+    for (int i = lid; i < 2 * (int)(NS + 2); i += lsz) {
+        int v = acc[i];
+        U32 u = (U32)i;
+        U32 slot = u <= NS ? u
+                 : u < 2 * (NS + 1) ? STATS_BINS + u - NS - 1
+                 : 2 * STATS_BINS + 1 + u - 2 * (NS + 1);
+        if (v) atomic_add(stats + slot, v);
+    }
+}
+
+inline void STEP_GLOBAL(__global const U8* A, __global U8* B, U32 W, U32 H, U32 NS,
+                        __global int* stats, __local int* acc) {
     U32 gid   = get_global_id(0);
     U32 gsize = get_global_size(0);
 
     U32 N = W * H;
+    if (stats) {
+        STATS_BEGIN(acc, NS);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
 
     for (U32 id = gid; id < N; id += gsize) {
-        U32 y = id / W;
-        U32 x = id % W;
+        int y = (int)(id / W);
+        int x = (int)(id % W);
+
+        U8 nb[8];
+        nb[0] = AT(A, x-1, y-1, W, H);
+        nb[1] = AT(A, x,   y-1, W, H);
+        nb[2] = AT(A, x+1, y-1, W, H);
+        nb[3] = AT(A, x-1, y,   W, H);
+        nb[4] = AT(A, x+1, y,   W, H);
+        nb[5] = AT(A, x-1, y+1, W, H);
+        nb[6] = AT(A, x,   y+1, W, H);
+        nb[7] = AT(A, x+1, y+1, W, H);
 
         U8 v   = A[id];
-        U8 out = v;
-
-        if (v != 0) {
-            int n = CN(A, (int)x,(int)y, W,H, v);
-            if (!(n == 2 || n == 3)) out = 0;
-        } else {
-            U8 pick = 0;
-            for (U8 s = 1; s <= (U8)NS; ++s) {
-                int n = CN(A, (int)x,(int)y, W,H, s);
-                if (n == 3) { pick = s; break; }
+        U8 out = RULE(v, nb, NS);
+        B[id] = out;
+        if (stats) STATS_CELL(acc, NS, id, v, out);
+    }
+    if (stats) STATS_END(stats, acc, NS);
+}
+
+__kernel void life_step(__global const U8* A, __global U8* B, const U32 argW, const U32 argH, const U32 argNS,
+                        __global int* stats) {
+    __local int acc[STATS_LOCAL];
+    STEP_GLOBAL(A, B, SPEC_W(argW), SPEC_H(argH), SPEC_NS(argNS), stats, acc);
+}
+inline int STEP_TILE(__global const U8* A, __global U8* B, U32 W, U32 H, U32 NS,
+                     __local U8* tile, int x0, int y0, U8* in, U8* out) {
+    int lx = (int)get_local_id(0);
+    int ly = (int)get_local_id(1);
+    int tw = (int)get_local_size(0);
+    int th = (int)get_local_size(1);
+    int pw = tw + 2;
+    int ph = th + 2;
+
+    for (int i = ly * tw + lx; i < pw * ph; i += tw * th) {
+        int ty = i / pw;
+        int tx = i - ty * pw;
+        tile[i] = AT(A, x0 + tx - 1, y0 + ty - 1, W, H);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    *in = *out = 0;
+    int x = x0 + lx;
+    int y = y0 + ly;
+    if ((U32)x >= W || (U32)y >= H) return 0;
+
+    int c = (ly + 1) * pw + (lx + 1);
+    U8 nb[8];
+    nb[0] = tile[c - pw - 1];
+    nb[1] = tile[c - pw];
+    nb[2] = tile[c - pw + 1];
+    nb[3] = tile[c - 1];
+    nb[4] = tile[c + 1];
+    nb[5] = tile[c + pw - 1];
+    nb[6] = tile[c + pw];
+    nb[7] = tile[c + pw + 1];
+
+    *in  = tile[c];
+    *out = RULE(*in, nb, NS);
+    B[(U32)y * W + (U32)x] = *out;
+    return *out != *in;
+}
+
+__kernel void life_step_tiled(__global const U8* A, __global U8* B, const U32 argW, const U32 argH, const U32 argNS,
+                              __global int* stats, __local U8* tile) {
+    __local int acc[STATS_LOCAL];
+    const U32 W  = SPEC_W(argW);
+    const U32 H  = SPEC_H(argH);
+    const U32 NS = SPEC_NS(argNS);
+
+    int x0 = (int)(get_group_id(0) * get_local_size(0));
+    int y0 = (int)(get_group_id(1) * get_local_size(1));
+    U8 in, out;
+    if (stats) STATS_BEGIN(acc, NS);
+    STEP_TILE(A, B, W, H, NS, tile, x0, y0, &in, &out);
+    if (stats) {
+        U32 id = (U32)(y0 + (int)get_local_id(1)) * W + (U32)(x0 + (int)get_local_id(0));
+        STATS_CELL(acc, NS, id, in, out);
+        STATS_END(stats, acc, NS);
+    }
+}
+
+__kernel void tiles_compact(__global const U32* changed, __global U32* next,
+                            __global U32* list, __global U32* count,
+                            const U32 TX, const U32 TY) {
+    U32 t = get_global_id(0);
+    if (t >= TX * TY) return;
+
+    int tx = (int)(t % TX);
+    int ty = (int)(t / TX);
+
+    int active = 0;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+#if LIFE_WRAP
+            int nx = WRAP(tx + dx, TX);
+            int ny = WRAP(ty + dy, TY);
+            active |= changed[(U32)ny * TX + (U32)nx] != 0u;
+#else
+            if (IB(tx + dx, ty + dy, TX, TY))
+                active |= changed[(U32)(ty + dy) * TX + (U32)(tx + dx)] != 0u;
+#endif
+        }
+    }
+
+    next[t] = 0u;
+    if (active) list[atomic_inc(count)] = t;
+}
+
+__kernel void life_step_active(__global const U8* A, __global U8* B, const U32 argW, const U32 argH, const U32 argNS,
+                               __global int* stats, __local U8* tile,
+                               __global const U32* list, __global const U32* count,
+                               __global U32* changed, const U32 TX) {
+    __local int acc[STATS_LOCAL];
+    const U32 W  = SPEC_W(argW);
+    const U32 H  = SPEC_H(argH);
+    const U32 NS = SPEC_NS(argNS);
+
+    U32 g = get_group_id(0);
+    if (g >= *count) return;
+
+    U32 t = list[g];
+    int x0 = (int)((t % TX) * get_local_size(0));
+    int y0 = (int)((t / TX) * get_local_size(1));
+
+    U8 in, out;
+    if (stats) STATS_BEGIN(acc, NS);
+    if (STEP_TILE(A, B, W, H, NS, tile, x0, y0, &in, &out))
+        changed[t] = 1u;
+    if (stats) {
+        U32 id = (U32)(y0 + (int)get_local_id(1)) * W + (U32)(x0 + (int)get_local_id(0));
+        STATS_CELL(acc, NS, id, in, out);
+        STATS_END(stats, acc, NS);
+    }
+}
+
+__kernel void life_step_temporal(__global const U8* A, __global U8* B, const U32 argW, const U32 argH, const U32 argNS,
+                                 __global int* stats, const U32 K, const U32 TW, const U32 TH,
+                                 __local U8* tA, __local U8* tB) {
+    __local int acc[STATS_LOCAL];
+    const U32 W  = SPEC_W(argW);
+    const U32 H  = SPEC_H(argH);
+    const U32 NS = SPEC_NS(argNS);
+
+    int lid = (int)get_local_id(0);
+    int lsz = (int)get_local_size(0);
+    int k   = (int)K;
+    int x0  = (int)(get_group_id(0) * TW) - k;
+    int y0  = (int)(get_group_id(1) * TH) - k;
+    int pw  = (int)TW + 2 * k;
+    int ph  = (int)TH + 2 * k;
+
+    for (int i = lid; i < pw * ph; i += lsz) {
+        int ty = i / pw;
+        int tx = i - ty * pw;
+        tA[i] = AT(A, x0 + tx, y0 + ty, W, H);
+    }
+    if (stats) STATS_BEGIN(acc, NS);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int g = 1; g <= k; ++g) {
+        int iw = pw - 2 * g;
+        int ih = ph - 2 * g;
+        for (int i = lid; i < iw * ih; i += lsz) {
+            int ty = i / iw + g;
+            int tx = i - (ty - g) * iw + g;
+            int c  = ty * pw + tx;
+            U8 out = 0;
+            if (INSIDE(x0 + tx, y0 + ty, W, H)) {
+                U8 nb[8];
+                nb[0] = tA[c - pw - 1];
+                nb[1] = tA[c - pw];
+                nb[2] = tA[c - pw + 1];
+                nb[3] = tA[c - 1];
+                nb[4] = tA[c + 1];
+                nb[5] = tA[c + pw - 1];
+                nb[6] = tA[c + pw];
+                nb[7] = tA[c + pw + 1];
+                out = RULE(tA[c], nb, NS);
             }
-            out = pick;
+            // Only the tile's own cells count, once per sub-step, so a cell
+            // born and killed within the launch still shows up. The hash
+            // deltas add up to the change over the whole launch.
+            int gx = x0 + tx;
+            int gy = y0 + ty;
+            if (stats && (U32)(tx - k) < TW && (U32)(ty - k) < TH && (U32)gx < W && (U32)gy < H)
+                STATS_CELL(acc, NS, (U32)gy * W + (U32)gx, tA[c], out);
+            tB[c] = out;
         }
+        barrier(CLK_LOCAL_MEM_FENCE);
 
-        B[id] = out;
+        __local U8* t = tA;
+        tA = tB;
+        tB = t;
     }
+
+    for (int i = lid; i < (int)(TW * TH); i += lsz) {
+        int ty = i / (int)TW;
+        int tx = i - ty * (int)TW;
+        int x = x0 + k + tx;
+        int y = y0 + k + ty;
+        if ((U32)x < W && (U32)y < H) {
+            U32 id = (U32)y * W + (U32)x;
+            U8 out = tA[(ty + k) * pw + tx + k];
+            B[id] = out;
+        }
+    }
+    if (stats) STATS_END(stats, acc, NS);
 }
-__kernel void pipe_producer(__global const uchar* grid,
-                            const uint            N,
-                            write_only pipe uint  outPipe)
-{
-    uint gid    = get_global_id(0);
-    uint stride = get_global_size(0);
 
-    uint count = 0;
-    for (uint i = gid; i < N; i += stride) {
-        if (grid[i] != (uchar)0)
-            ++count;
+inline U32 WORD(__global const U32* g,int xw,int y,U32 ww,U32 h) {
+    return IB(xw,y,ww,h) ? g[(U32)y*ww+(U32)xw] : 0u;
+}
+
+inline void STEP_WORD(__global const U32* A, __global U32* B, U32 W, U32 H, U32 NS, int xw, int y,
+                      __local int* acc) {
+    U32 WW = (W + 31u) >> 5;
+    U32 plane = WW * H;
+    U32 id    = (U32)y * WW + (U32)xw;
+
+    U32 occ = 0;
+    for (U32 p = 0; p < NS; ++p) occ |= A[p * plane + id];
+
+    U32 rem  = W - ((U32)xw << 5);
+    U32 mask = (rem < 32u) ? (1u << rem) - 1u : 0xFFFFFFFFu;
+
+    U32 taken = 0;
+    for (U32 p = 0; p < NS; ++p) {
+        __global const U32* P = A + p * plane;
+
+        U32 ul = WORD(P, xw-1, y-1, WW, H), uc = WORD(P, xw, y-1, WW, H), ur = WORD(P, xw+1, y-1, WW, H);
+        U32 ml = WORD(P, xw-1, y,   WW, H), mc = P[id],                   mr = WORD(P, xw+1, y,   WW, H);
+        U32 dl = WORD(P, xw-1, y+1, WW, H), dc = WORD(P, xw, y+1, WW, H), dr = WORD(P, xw+1, y+1, WW, H);
+
+        U32 n0 = (uc << 1) | (ul >> 31), n1 = uc, n2 = (uc >> 1) | (ur << 31);
+        U32 n3 = (mc << 1) | (ml >> 31),           n4 = (mc >> 1) | (mr << 31);
+        U32 n5 = (dc << 1) | (dl >> 31), n6 = dc, n7 = (dc >> 1) | (dr << 31);
+
+        U32 sa = n0 ^ n1 ^ n2, ca = (n0 & n1) | (n2 & (n0 ^ n1));
+        U32 sb = n3 ^ n4 ^ n5, cb = (n3 & n4) | (n5 & (n3 ^ n4));
+        U32 sc = n6 ^ n7,      cc = n6 & n7;
+
+        U32 b0 = sa ^ sb ^ sc, cd = (sa & sb) | (sc & (sa ^ sb));
+        U32 t0 = ca ^ cb ^ cc, t1 = (ca & cb) | (cc & (ca ^ cb));
+        U32 b1 = t0 ^ cd,      t2 = t0 & cd;
+
+        U32 two3 = b1 & ~(t1 | t2);
+        U32 born = two3 & b0 & ~occ & ~taken;
+        taken |= born;
+
+        U32 out = ((two3 & mc) | born) & mask;
+        B[p * plane + id] = out;
+        if (acc && out != mc) {
+            U32 b = popcount(out & ~mc), d = popcount(mc & ~out);
+            if (b) atomic_add(acc + p + 1, (int)b);
+            if (d) atomic_add(acc + NS + 2 + p, (int)d);
+            STATS_HASH(acc, NS, p * plane + id, mc, out);
+        }
+    }
+}
+
+__kernel void life_step_bits(__global const U32* A, __global U32* B, const U32 argW, const U32 argH, const U32 argNS,
+                             __global int* stats) {
+    __local int acc[STATS_LOCAL];
+    const U32 W  = SPEC_W(argW);
+    const U32 H  = SPEC_H(argH);
+    const U32 NS = SPEC_NS(argNS);
+
+    int xw = (int)get_global_id(0);
+    int y  = (int)get_global_id(1);
+    U32 WW = (W + 31u) >> 5;
+    if (stats) {
+        STATS_BEGIN(acc, NS);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if ((U32)xw < WW && (U32)y < H)
+        STEP_WORD(A, B, W, H, NS, xw, y, stats ? acc : 0);
+    if (stats) STATS_END(stats, acc, NS);
+}
+#ifdef DEVICE_ENQUEUE
+// Autonomous runs: a single work-item scheduler folds the previous
+// generation's stats into ctl, checks the stop conditions, and otherwise
+// enqueues one STEP_GLOBAL launch plus itself (with A and B swapped) to
+// run after it, so no generation needs the host.
+// ctl (longs): CTL_BUDGET generations to run, CTL_DONE, CTL_REASON (0 still
+// running, 1 budget, 2 at or below CTL_MIN, 3 at or above CTL_MAX, 4
+// enqueue failed), CTL_LIVE, CTL_MIN (< 0 off), CTL_MAX (0 off), the two
+// hash lanes, then the per-species populations from CTL_POP + 1.
+#define CTL_BUDGET 0
+#define CTL_DONE   1
+#define CTL_REASON 2
+#define CTL_LIVE   3
+#define CTL_MIN    4
+#define CTL_MAX    5
+#define CTL_HASH   6
+#define CTL_POP    8
+
+void SCHEDULE(__global U8* A, __global U8* B, U32 W, U32 H, U32 NS,
+              __global int* stats, __global long* ctl, U32 group) {
+    long live = 0;
+    for (U32 s = 1; s <= NS; ++s) {
+        ctl[CTL_POP + s] += stats[s] - stats[STATS_BINS + s];
+        live += ctl[CTL_POP + s];
+        stats[s] = 0;
+        stats[STATS_BINS + s] = 0;
+    }
+    for (U32 l = 0; l < 2; ++l) {
+        ctl[CTL_HASH + l] = (long)((U32)ctl[CTL_HASH + l] + (U32)stats[2 * STATS_BINS + 1 + l]);
+        stats[2 * STATS_BINS + 1 + l] = 0;
     }
+    ctl[CTL_LIVE] = live;
+
+    if (ctl[CTL_DONE] >= ctl[CTL_BUDGET])         { ctl[CTL_REASON] = 1; return; }
+    if (ctl[CTL_MIN] >= 0 && live <= ctl[CTL_MIN]) { ctl[CTL_REASON] = 2; return; }
+    if (ctl[CTL_MAX] > 0 && live >= ctl[CTL_MAX])  { ctl[CTL_REASON] = 3; return; }
+
+    queue_t q = get_default_queue();
+    clk_event_t stepped;
+    int err = enqueue_kernel(q, CLK_ENQUEUE_FLAGS_WAIT_KERNEL,
+        ndrange_1D((size_t)(W * H + group - 1) / group * group, (size_t)group), 0, NULL, &stepped,
+        ^(local void* acc) { STEP_GLOBAL(A, B, W, H, NS, stats, (local int*)acc); },
+        (uint)(STATS_LOCAL * sizeof(int)));
+    if (err != CLK_SUCCESS) { ctl[CTL_REASON] = 4; return; }
+
+    ctl[CTL_DONE] += 1;
+    err = enqueue_kernel(q, CLK_ENQUEUE_FLAGS_NO_WAIT, ndrange_1D(1), 1, &stepped, NULL,
+        ^{ SCHEDULE(B, A, W, H, NS, stats, ctl, group); });
+    release_event(stepped);
+    if (err != CLK_SUCCESS) ctl[CTL_REASON] = 4;
+}
 
-    write_pipe(outPipe, &count);
+__kernel void life_schedule(__global U8* A, __global U8* B, const U32 W, const U32 H, const U32 NS,
+                            __global int* stats, __global long* ctl, const U32 group) {
+    SCHEDULE(A, B, W, H, NS, stats, ctl, group);
 }
+#endif
 
-__kernel void pipe_consumer(read_only pipe uint  inPipe,
-                            __global uint*       partial,
-                            const uint           numItems)
+// Colorizers writing straight into a shared GL texture; `palette` is the
+// 256-entry species_palette() table.
+__kernel void colorize_image(__global const U8* grid,
+                             __write_only image2d_t img,
+                             __constant uchar4* palette,
+                             const U32 W, const U32 H)
 {
-    uint gid = get_global_id(0);
-    if (gid >= numItems) return;
+    int x = get_global_id(0), y = get_global_id(1);
+    if ((U32)x >= W || (U32)y >= H) return;
+
+    write_imagef(img, (int2)(x, y), convert_float4(palette[grid[(U32)y * W + (U32)x]]) / 255.0f);
+}
+
+__kernel void colorize_planes(__global const U32* planes,
+                              __write_only image2d_t img,
+                              __constant uchar4* palette,
+                              const U32 W, const U32 H,
+                              const U32 NS, const U32 WW)
+{
+    int x = get_global_id(0), y = get_global_id(1);
+    if ((U32)x >= W || (U32)y >= H) return;
+
+    U32 id = (U32)y * WW + ((U32)x >> 5), bit = 1u << ((U32)x & 31u);
+    U32 s = 0;
+    for (U32 p = 0; p < NS && !s; ++p)
+        if (planes[p * WW * H + id] & bit) s = p + 1;
 
-    uint v = 0;
-    read_pipe(inPipe, &v);
-    partial[gid] = v;
+    write_imagef(img, (int2)(x, y), convert_float4(palette[s]) / 255.0f);
 }
 )CLC";
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+struct LifeEngine {
+    virtual ~LifeEngine() = default;
+
+    // step() may leave `host` stale; engines that keep their state off the
+    // host refresh it in sync_host(), which callers invoke before reading.
+    virtual void step(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host) = 0;
+    // `steps` calls of step() back to back. Engines that queue work on a
+    // device override it to enqueue them all before waiting once.
+    virtual void step_n(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host, uint32_t steps) {
+        for (uint32_t i = 0; i < steps; ++i) step(w, h, numSpecies, host);
+    }
+    virtual void sync_host(std::vector<unsigned char>& host) {
+        (void)host;
+    }
+    virtual void shutdown() = 0;
+
+    // Period in generations of the cycle the grid has settled into, or 0
+    // while none is known; only engines that hash the grid find one. Since
+    // the state repeats, skip() may advance the generation count by any
+    // multiple of it without stepping.
+    virtual uint64_t cycle_period() const {
+        return 0;
+    }
+    virtual void skip(uint64_t generations) {
+        (void)generations;
+    }
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Host copy of RULE() in kernel_source.h: survive on 2 or 3 same-species
+// neighbors, birth of the lowest species with exactly 3.
+inline unsigned char life_rule(unsigned char v, const unsigned char nb[8], uint32_t ns)
+{
+    if (v != 0) {
+        int c = 0;
+        for (int i = 0; i < 8; ++i) c += (nb[i] == v);
+        return (c == 2 || c == 3) ? v : 0;
+    }
+
+    unsigned char pick = 0;
+    for (int i = 0; i < 8; ++i) {
+        unsigned char s = nb[i];
+        if (s == 0 || s > ns || (pick != 0 && s >= pick)) continue;
+        int c = 0;
+        for (int j = 0; j < 8; ++j) c += (nb[j] == s);
+        if (c == 3) pick = s;
+    }
+    return pick;
+}
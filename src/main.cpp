@@ -4,19 +4,38 @@
 #include <cstdio>
 #include <cstdlib>
 #include <random>
+#include <cstring>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <algorithm>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#if defined(_WIN32)
+#define NOMINMAX
+#define GLFW_EXPOSE_NATIVE_WIN32
+#define GLFW_EXPOSE_NATIVE_WGL
+#elif defined(__linux__)
+#define GLFW_EXPOSE_NATIVE_X11
+#define GLFW_EXPOSE_NATIVE_GLX
+#endif
+#include <GLFW/glfw3native.h>
+
+#include "config.h"
 #include "cl_life.h"
+#include "cl_split_life.h"
+#include "cpu_life.h"
+#include "hashlife.h"
+#include "sparse_life.h"
 #include "kernel_source.h"
 #include "renderer.h"
 #include "cl_colorizer.h"
 #include "cpu_color_kernel.h"
-
-static const uint32_t GRID_W = 1024;
-static const uint32_t GRID_H = 768;
-static const uint32_t GRID_N = GRID_W * GRID_H;
+#include "sim_thread.h"
+#include "stats_log.h"
+#include "program_cache.h"
 
 static uint32_t choose_species_count()
 {
@@ -26,16 +45,19 @@ static uint32_t choose_species_count()
     return dist(gen);
 }
 
+// A fixed seed reproduces the same grid run to run; 0 draws one from
+// random_device.
 static void init_species_grid(std::vector<unsigned char>& grid,
-    uint32_t numSpecies)
+    uint32_t w, uint32_t h, uint32_t numSpecies, uint32_t seed)
 {
-    grid.resize(GRID_N);
+    const size_t n = (size_t)w * h;
+    grid.resize(n);
 
     std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> sp(1, (int)numSpecies);
+    std::mt19937 gen(seed ? seed : rd());
+    std::uniform_int_distribution<int> sp(numSpecies == 1 ? 0 : 1, (int)numSpecies);
 
-    for (uint32_t i = 0; i < GRID_N; ++i) {
+    for (size_t i = 0; i < n; ++i) {
         grid[i] = static_cast<unsigned char>(sp(gen));
     }
 }
@@ -45,8 +67,451 @@ static void glfw_error_callback(int error, const char* desc)
     std::cerr << "GLFW error " << error << ": " << desc << "\n";
 }
 
-int main()
+// Context properties that let CLLife share buffers with this window's GL
+// context; empty where we have no native handles.
+static std::vector<cl_context_properties> gl_share_properties(GLFWwindow* window)
+{
+    std::vector<cl_context_properties> props;
+#if defined(_WIN32)
+    props = {
+        CL_GL_CONTEXT_KHR, (cl_context_properties)glfwGetWGLContext(window),
+        CL_WGL_HDC_KHR,    (cl_context_properties)GetDC(glfwGetWin32Window(window))
+    };
+#elif defined(__linux__)
+    props = {
+        CL_GL_CONTEXT_KHR,  (cl_context_properties)glfwGetGLXContext(window),
+        CL_GLX_DISPLAY_KHR, (cl_context_properties)glfwGetX11Display()
+    };
+#else
+    (void)window;
+#endif
+    return props;
+}
+
+struct Options {
+    std::string engine = "cl";
+    std::string loadMc;
+    std::string saveMc;
+    uint32_t    stepLog2 = 0;
+    bool        superspeed = false;
+    std::string rule = "B3/S23";
+    bool        wrap = false;
+    bool        generic = false;
+    bool        benchSpecialization = false;
+    std::string cpuIsa;
+    uint32_t    rebalance = 32;
+    bool        allDevices = false;
+    uint32_t    subDevices = 0;
+    uint32_t    halo = 1;
+    bool        interop = true;
+    std::string render = "indexed";
+    bool        pbo = true;
+    uint32_t    framesInFlight = 2;
+    bool        simThread = true;
+    double      simRate = 0.0;
+    bool        headless = false;
+    uint32_t    width = GRID_W;
+    uint32_t    height = GRID_H;
+    uint32_t    species = 0;
+    uint32_t    seed = 0;
+    uint64_t    gens = 1000;
+    uint32_t    batch = 0;
+    bool        deviceLoop = false;
+    int64_t     stopBelow = -1;
+    int64_t     stopAbove = 0;
+    std::string clCache = "cl_cache";
+    std::string out;
+    std::string statsLog;
+    CycleAction onCycle = CycleAction::Report;
+};
+
+static bool parse_args(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(a, "--engine") && hasValue)         opt.engine = argv[++i];
+        else if (!std::strcmp(a, "--mc") && hasValue)        opt.loadMc = argv[++i];
+        else if (!std::strcmp(a, "--save-mc") && hasValue)   opt.saveMc = argv[++i];
+        else if (!std::strcmp(a, "--step-log2") && hasValue) opt.stepLog2 = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--superspeed"))            opt.superspeed = true;
+        else if (!std::strcmp(a, "--rule") && hasValue)      opt.rule = argv[++i];
+        else if (!std::strcmp(a, "--wrap"))                  opt.wrap = true;
+        else if (!std::strcmp(a, "--generic"))               opt.generic = true;
+        else if (!std::strcmp(a, "--bench-specialization"))  opt.benchSpecialization = true;
+        else if (!std::strcmp(a, "--cpu-isa") && hasValue)   opt.cpuIsa = argv[++i];
+        else if (!std::strcmp(a, "--rebalance") && hasValue) opt.rebalance = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--all-devices"))           opt.allDevices = true;
+        else if (!std::strcmp(a, "--sub-devices") && hasValue) opt.subDevices = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--halo") && hasValue)      opt.halo = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--no-interop"))            opt.interop = false;
+        else if (!std::strcmp(a, "--render") && hasValue)    opt.render = argv[++i];
+        else if (!std::strcmp(a, "--no-pbo"))                opt.pbo = false;
+        else if (!std::strcmp(a, "--frames-in-flight") && hasValue) opt.framesInFlight = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--no-sim-thread"))         opt.simThread = false;
+        else if (!std::strcmp(a, "--sim-rate") && hasValue)  opt.simRate = std::strtod(argv[++i], nullptr);
+        else if (!std::strcmp(a, "--headless"))              opt.headless = true;
+        else if (!std::strcmp(a, "--size") && hasValue) {
+            char* end = nullptr;
+            opt.width = (uint32_t)std::strtoul(argv[++i], &end, 10);
+            opt.height = (end && (*end == 'x' || *end == 'X')) ? (uint32_t)std::strtoul(end + 1, nullptr, 10) : 0;
+        }
+        else if (!std::strcmp(a, "--species") && hasValue)   opt.species = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--seed") && hasValue)      opt.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--gens") && hasValue)      opt.gens = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--batch") && hasValue)     opt.batch = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--device-loop"))           opt.deviceLoop = true;
+        else if (!std::strcmp(a, "--cl-cache") && hasValue)  opt.clCache = argv[++i];
+        else if (!std::strcmp(a, "--no-cl-cache"))           opt.clCache.clear();
+        else if (!std::strcmp(a, "--stop-below") && hasValue) opt.stopBelow = std::strtoll(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--stop-above") && hasValue) opt.stopAbove = std::strtoll(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--out") && hasValue)       opt.out = argv[++i];
+        else if (!std::strcmp(a, "--stats-log") && hasValue) opt.statsLog = argv[++i];
+        else if (!std::strcmp(a, "--on-cycle") && hasValue) {
+            const char* v = argv[++i];
+            if (!std::strcmp(v, "off"))         opt.onCycle = CycleAction::Off;
+            else if (!std::strcmp(v, "report")) opt.onCycle = CycleAction::Report;
+            else if (!std::strcmp(v, "stop"))   opt.onCycle = CycleAction::Stop;
+            else if (!std::strcmp(v, "skip"))   opt.onCycle = CycleAction::Skip;
+            else {
+                std::cerr << "Unknown --on-cycle action: " << v << "\n";
+                return false;
+            }
+        }
+        else {
+            std::cerr << "Unknown argument: " << a << "\n";
+            return false;
+        }
+    }
+    if (opt.width == 0 || opt.height == 0) {
+        std::cerr << "Invalid --size, expected WxH\n";
+        return false;
+    }
+    if (opt.species > 255) {
+        std::cerr << "At most 255 species are supported\n";
+        return false;
+    }
+    if (opt.render != "indexed" && opt.render != "rgba") {
+        std::cerr << "Unknown render mode: " << opt.render << "\n";
+        return false;
+    }
+    if (!opt.cpuIsa.empty() && opt.cpuIsa != "scalar" && opt.cpuIsa != "sse41"
+        && opt.cpuIsa != "avx2" && opt.cpuIsa != "avx512") {
+        std::cerr << "Unknown CPU ISA: " << opt.cpuIsa << "\n";
+        return false;
+    }
+    if (opt.engine != "cl" && opt.engine != "cpu" && opt.engine != "split"
+        && opt.engine != "hashlife" && opt.engine != "sparse") {
+        std::cerr << "Unknown engine: " << opt.engine << "\n";
+        return false;
+    }
+    return true;
+}
+
+static uint32_t species_count(const Options& opt)
+{
+    if (opt.engine == "hashlife") return 1;
+    return opt.species ? opt.species : choose_species_count();
+}
+
+// Every engine either front-end can run; create_engine() initializes the
+// one the options select.
+struct Engines {
+    CLLife      life;
+    HashLife    hashLife;
+    SparseLife  sparseLife;
+    CpuLife     cpuLife;
+    CLSplitLife splitLife;
+};
+
+// Only CLLife takes --rule and --wrap; the other engines hard-code Conway.
+static void warn_fixed_rule(const Options& opt, const char* engine)
+{
+    if (opt.rule != "B3/S23" || opt.wrap) {
+        std::cerr << "Warning: " << engine << " engine runs B3/S23 with a dead boundary\n";
+    }
+}
+
+static LifeEngine* create_engine(const Options& opt, Engines& e,
+    uint32_t w, uint32_t h, uint32_t numSpecies,
+    const std::vector<cl_context_properties>& glShare, bool headless)
+{
+    if (opt.engine == "hashlife") {
+        warn_fixed_rule(opt, "hashlife");
+        e.hashLife.init(w, h, numSpecies);
+        e.hashLife.set_step_log2(opt.stepLog2);
+        e.hashLife.set_superspeed(opt.superspeed);
+        if (!opt.loadMc.empty() && !e.hashLife.load_mc(opt.loadMc)) {
+            return nullptr;
+        }
+        return &e.hashLife;
+    }
+    if (opt.engine == "sparse") {
+        warn_fixed_rule(opt, "sparse");
+        e.sparseLife.init(w, h, numSpecies);
+        return &e.sparseLife;
+    }
+    if (opt.engine == "split") {
+        warn_fixed_rule(opt, "split");
+        e.splitLife.set_rebalance_interval(opt.rebalance);
+        e.splitLife.set_all_devices(opt.allDevices);
+        e.splitLife.set_sub_devices(opt.subDevices);
+        e.splitLife.set_halo(opt.halo);
+        if (!e.splitLife.init(w, h, numSpecies, LIFE_KERNEL_SRC)) {
+            std::cerr << "Failed to init OpenCL (split life)\n";
+            return nullptr;
+        }
+        return &e.splitLife;
+    }
+
+    const bool useCpu = (opt.engine == "cpu");
+    if (!e.life.set_rule(opt.rule.c_str())) {
+        std::cerr << "Invalid rule: " << opt.rule << "\n";
+        return nullptr;
+    }
+    e.life.set_wrap(opt.wrap);
+    e.life.set_specialize(!opt.generic);
+    e.life.set_bench_specialization(opt.benchSpecialization);
+    if (!glShare.empty()) {
+        e.life.set_gl_sharing(glShare);
+    }
+    // Headless runs read the grid back once and show no stats unless they
+    // are being logged or hashed for cycle detection.
+    e.life.set_frames_in_flight(headless ? 1 : opt.framesInFlight);
+    e.life.set_collect_stats(!headless || !opt.statsLog.empty() || opt.onCycle != CycleAction::Off);
+    e.life.set_cycle_detection(opt.onCycle != CycleAction::Off);
+    e.life.set_device_enqueue(headless && opt.deviceLoop);
+    if (!useCpu && e.life.init(w, h, numSpecies, LIFE_KERNEL_SRC)) {
+        e.life.set_work_items(0);
+        e.life.set_local_size(0);
+        return &e.life;
+    }
+
+    if (!useCpu) {
+        std::cerr << "Failed to init OpenCL (GPU life), falling back to CPU engine\n";
+        e.life.shutdown();
+    }
+    warn_fixed_rule(opt, "CPU");
+    e.cpuLife.init(w, h, numSpecies);
+    if (opt.cpuIsa == "scalar")      e.cpuLife.set_isa(CpuIsa::Scalar);
+    else if (opt.cpuIsa == "sse41")  e.cpuLife.set_isa(CpuIsa::SSE41);
+    else if (opt.cpuIsa == "avx2")   e.cpuLife.set_isa(CpuIsa::AVX2);
+    else if (opt.cpuIsa == "avx512") e.cpuLife.set_isa(CpuIsa::AVX512BW);
+    return &e.cpuLife;
+}
+
+// Per-generation species statistics and the grid hash behind cycle
+// detection come from the CL step kernels only.
+static bool open_stats_log(const Options& opt, Engines& e, LifeEngine* engine,
+    uint32_t numSpecies, StatsLog& log)
 {
+    if (opt.onCycle >= CycleAction::Stop && engine != &e.life) {
+        std::cerr << "Warning: --on-cycle stop|skip needs the cl engine, ignoring\n";
+    }
+    if (opt.statsLog.empty()) return true;
+    if (engine != &e.life) {
+        std::cerr << "Warning: --stats-log needs the cl engine, not logging\n";
+        return true;
+    }
+    if (!log.open(opt.statsLog, numSpecies)) return false;
+    e.life.set_stats_log(&log);
+    return true;
+}
+
+static uint64_t engine_generation(const Engines& e, const LifeEngine* engine)
+{
+    if (engine == &e.hashLife)   return e.hashLife.generation;
+    if (engine == &e.sparseLife) return e.sparseLife.generation;
+    if (engine == &e.splitLife)  return e.splitLife.generation;
+    if (engine == &e.cpuLife)    return e.cpuLife.generation;
+    return e.life.generation;
+}
+
+static std::string engine_name(const Engines& e, const LifeEngine* engine)
+{
+    if (engine == &e.hashLife)   return "hashlife";
+    if (engine == &e.sparseLife) return "sparse";
+    if (engine == &e.splitLife)  return "split";
+    if (engine == &e.cpuLife)    return std::string("cpu/") + CpuLife::isa_name(e.cpuLife.isa);
+    return "cl";
+}
+
+// Binary PGM with one byte per cell holding the species index.
+static bool write_pgm(const std::string& path, uint32_t w, uint32_t h,
+    uint32_t numSpecies, const std::vector<unsigned char>& grid)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+    std::fprintf(f, "P5\n%u %u\n%u\n", w, h, numSpecies ? numSpecies : 1);
+    const size_t n = (size_t)w * h;
+    bool ok = grid.size() >= n && std::fwrite(grid.data(), 1, n, f) == n;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Failed to write " << path << "\n";
+    }
+    return ok;
+}
+
+// Startup cost of the OpenCL compiler: programs built from source (cold)
+// versus created from the on-disk binary cache (warm).
+static void report_program_builds(double initMs)
+{
+    const ProgramCacheStats s = program_cache_stats();
+    if (s.cold + s.warm == 0) return;
+    std::printf("init=%.1f ms | programs: %u cold (%.1f ms), %u warm (%.1f ms)\n",
+        initMs, s.cold, s.coldMs, s.warm, s.warmMs);
+}
+
+// Batch mode: no window, GL context, renderer or colorizer. Runs at least
+// opt.gens generations as fast as the engine goes, optionally writes the
+// final grid, and prints a one-run summary.
+static int run_headless(const Options& opt)
+{
+    const uint32_t w = opt.width;
+    const uint32_t h = opt.height;
+    const uint32_t numSpecies = species_count(opt);
+    std::vector<unsigned char> grid;
+    init_species_grid(grid, w, h, numSpecies, opt.seed);
+
+    StatsLog statsLog;
+    Engines engines;
+    const auto tInit = std::chrono::steady_clock::now();
+    LifeEngine* engine = create_engine(opt, engines, w, h, numSpecies, {}, true);
+    if (!engine) {
+        return -1;
+    }
+    const double initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tInit).count();
+    if (!open_stats_log(opt, engines, engine, numSpecies, statsLog)) {
+        engine->shutdown();
+        return -1;
+    }
+
+    // Steps go to the engine in batches of up to `batch`, which the CL
+    // engine enqueues without a host round-trip in between. A stats log
+    // wants one record per step, so it defaults to unbatched. The cycle
+    // check hashes once per batch: a detected period is then a multiple of
+    // the batch, which is still exact to skip by.
+    const uint32_t batch = opt.batch ? opt.batch : (opt.statsLog.empty() ? 64 : 1);
+    const uint64_t gen0 = engine_generation(engines, engine);
+    uint64_t steps = 0;
+    uint64_t skipped = 0;
+    uint64_t gensPerStep = 0;
+
+    // --device-loop hands the whole run to the engine, which chains the
+    // generations on the device and checks the stop conditions there.
+    const bool autonomous = opt.deviceLoop && engine == &engines.life;
+    if (opt.deviceLoop && !autonomous) {
+        std::cerr << "Warning: --device-loop needs the cl engine, stepping from the host\n";
+    }
+    if (!opt.deviceLoop && (opt.stopBelow >= 0 || opt.stopAbove > 0)) {
+        std::cerr << "Warning: --stop-below/--stop-above need --device-loop, ignoring\n";
+    }
+    AutoStop stop = AutoStop::Budget;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (autonomous) {
+        stop = engines.life.run_autonomous(w, h, numSpecies, grid,
+            opt.gens, opt.stopBelow, opt.stopAbove);
+        steps = engines.life.generation - gen0;
+    }
+    while (!autonomous && engine_generation(engines, engine) - gen0 < opt.gens) {
+        // The first step is alone so the batch can be sized to the
+        // generations one step covers without overshooting --gens.
+        const uint64_t before = engine_generation(engines, engine);
+        const uint64_t left = opt.gens - (before - gen0);
+        const uint32_t n = gensPerStep
+            ? (uint32_t)std::min<uint64_t>(batch, (left + gensPerStep - 1) / gensPerStep)
+            : 1;
+        engine->step_n(w, h, numSpecies, grid, n);
+        steps += n;
+        if (!gensPerStep) gensPerStep = std::max<uint64_t>(1, engine_generation(engines, engine) - before);
+
+        // Once the grid repeats, whole periods of the remaining run change
+        // nothing and can be skipped; the leftover is still simulated.
+        const uint64_t period = engine->cycle_period();
+        if (period && opt.onCycle == CycleAction::Stop) break;
+        const uint64_t done = engine_generation(engines, engine) - gen0;
+        if (period && opt.onCycle == CycleAction::Skip && done < opt.gens) {
+            const uint64_t jump = (opt.gens - done) / period * period;
+            engine->skip(jump);
+            skipped += jump;
+        }
+    }
+    engine->sync_host(grid);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const uint64_t gens = engine_generation(engines, engine) - gen0;
+    const uint64_t simulated = gens - skipped;
+
+    uint64_t live = 0;
+    for (unsigned char c : grid) live += (c != 0);
+
+    report_program_builds(initMs);
+    std::printf("engine=%s size=%ux%u species=%u seed=%u gens=%llu steps=%llu\n",
+        engine_name(engines, engine).c_str(), w, h, numSpecies, opt.seed,
+        (unsigned long long)gens, (unsigned long long)steps);
+    std::printf("time=%.3f s | %.1f gen/s | %.3f Gcell/s | %.3f ms/step | live=%llu\n",
+        secs, secs > 0.0 ? simulated / secs : 0.0,
+        secs > 0.0 ? (double)simulated * w * h / secs * 1e-9 : 0.0,
+        steps ? secs * 1000.0 / steps : 0.0, (unsigned long long)live);
+    if (engine == &engines.life && engines.life.lastBatchSteps > 1) {
+        std::printf("device: %.3f ms/launch | last batch of %u: %.3f ms\n",
+            engines.life.lastKernelMs, engines.life.lastBatchSteps, engines.life.lastBatchMs);
+    }
+    if (autonomous) {
+        static const char* reasons[] = { "", "budget", "population at or below --stop-below",
+            "population at or above --stop-above", "failure" };
+        std::printf("autonomous: %s queue | stopped on %s\n",
+            engines.life.scheduleK ? "device" : "host", reasons[static_cast<int>(stop)]);
+    }
+    if (engine->cycle_period()) {
+        std::printf("cycle: period=%llu detected at gen %llu | skipped=%llu gens\n",
+            (unsigned long long)engine->cycle_period(),
+            (unsigned long long)engines.life.cycleGeneration, (unsigned long long)skipped);
+    }
+
+    int rc = 0;
+    if (!opt.out.empty() && !write_pgm(opt.out, w, h, numSpecies, grid)) {
+        rc = -1;
+    }
+    if (engine == &engines.hashLife && !opt.saveMc.empty()) {
+        engines.hashLife.save_mc(opt.saveMc);
+    }
+    engine->shutdown();
+    statsLog.close();
+    return rc;
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        std::cerr << "Usage: " << argv[0]
+            << " [--engine cl|cpu|split|hashlife|sparse] [--mc file.mc] [--save-mc file.mc]"
+               " [--step-log2 k] [--superspeed] [--rule B3/S23] [--wrap] [--generic] [--bench-specialization]"
+               " [--cpu-isa scalar|sse41|avx2|avx512] [--rebalance steps]"
+               " [--all-devices] [--sub-devices n] [--halo k] [--no-interop]"
+               " [--render indexed|rgba] [--no-pbo] [--frames-in-flight n]"
+               " [--no-sim-thread] [--sim-rate gens_per_sec]"
+               " [--size WxH] [--species n] [--seed s]"
+               " [--headless [--gens n] [--batch n] [--device-loop [--stop-below n] [--stop-above n]]"
+               " [--out file.pgm]] [--stats-log file.csv|file.bin] [--cl-cache dir | --no-cl-cache]"
+               " [--on-cycle off|report|stop|skip]\n";
+        return -1;
+    }
+    set_program_cache_dir(opt.clCache);
+    if (opt.headless) {
+        return run_headless(opt);
+    }
+
+    const bool useHashLife = (opt.engine == "hashlife");
+    const bool useSparse = (opt.engine == "sparse");
+    const bool useSplit = (opt.engine == "split");
+    const uint32_t gridW = opt.width;
+    const uint32_t gridH = opt.height;
+
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit()) {
         std::cerr << "Failed to init GLFW\n";
@@ -76,53 +541,132 @@ int main()
     }
 
     Renderer renderer;
-    if (!renderer.init(GRID_W, GRID_H)) {
+    if (!renderer.init(gridW, gridH)) {
         std::cerr << "Renderer init failed\n";
         glfwDestroyWindow(window);
         glfwTerminate();
         return -1;
     }
 
-    uint32_t numSpecies = choose_species_count();
+    const uint32_t numSpecies = species_count(opt);
     std::vector<unsigned char> speciesGrid;
-    init_species_grid(speciesGrid, numSpecies);
-
-    CLLife life;
-    if (!life.init(GRID_W, GRID_H, numSpecies, LIFE_KERNEL_SRC)) {
-        std::cerr << "Failed to init OpenCL (GPU life)\n";
+    init_species_grid(speciesGrid, gridW, gridH, numSpecies, opt.seed);
+
+    StatsLog statsLog;
+    Engines engines;
+    const auto tInit = std::chrono::steady_clock::now();
+    LifeEngine* engine = create_engine(opt, engines, gridW, gridH, numSpecies,
+        opt.interop ? gl_share_properties(window) : std::vector<cl_context_properties>(), false);
+    if (engine && !open_stats_log(opt, engines, engine, numSpecies, statsLog)) {
+        engine->shutdown();
+        engine = nullptr;
+    }
+    if (!engine) {
         glfwDestroyWindow(window);
         glfwTerminate();
         return -1;
     }
-
-    life.set_work_items(0);
-    life.set_local_size(0);
-
+    CLLife& life = engines.life;
+    HashLife& hashLife = engines.hashLife;
+    SparseLife& sparseLife = engines.sparseLife;
+    CpuLife& cpuLife = engines.cpuLife;
+    CLSplitLife& splitLife = engines.splitLife;
+    const bool useCpu = (engine == &cpuLife);
+
+    // Indexed rendering uploads the species grid as-is and colors it in the
+    // fragment shader, so the RGBA colorizer is only needed for --render rgba.
+    const bool indexed = (opt.render == "indexed");
+    renderer.setPalette(numSpecies);
+    renderer.setIndexed(indexed);
+    renderer.setPboStreaming(opt.pbo);
 
     CLColorizer colorizer;
-    if (!colorizer.init(GRID_W, GRID_H, COLOR_KERNEL_SRC)) {
-        std::cerr << "Failed to init CPU OpenCL colorizer\n";
-        life.shutdown();
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
+    if (!indexed && !colorizer.init(gridW, gridH, numSpecies, COLOR_KERNEL_SRC)) {
+        std::cerr << "Warning: CPU OpenCL colorizer unavailable, colorizing on the host\n";
+        colorizer.shutdown();
     }
+    report_program_builds(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - tInit).count());
 
     std::vector<unsigned char> rgba;
 
+    // With CL/GL sharing the grid is colorized on the GPU straight into
+    // renderer.tex and never visits the host.
+    bool interop = (engine == &life) && life.attach_gl_texture(GL_TEXTURE_2D, renderer.tex);
+    if (interop) {
+        std::cout << "CL/GL interop enabled\n";
+        renderer.setIndexed(false);
+    }
+
+    std::function<uint64_t()> generationOf = [&]() -> uint64_t {
+        return engine_generation(engines, engine);
+    };
+
+    // By default the engine steps on its own thread and the loop below only
+    // shows the newest generation, so vsync no longer caps the simulation.
+    const bool threaded = opt.simThread;
+    SimThread sim;
+    if (threaded) {
+        sim.start(engine, gridW, gridH, numSpecies, speciesGrid, generationOf, opt.simRate, opt.onCycle);
+    }
+    else if (opt.simRate > 0.0) {
+        std::cerr << "Warning: --sim-rate needs the sim thread, ignoring\n";
+    }
+
     auto tLast = std::chrono::high_resolution_clock::now();
     double fpsAccum = 0.0;
     int    fpsFrames = 0;
     double fps = 0.0;
+    double simRate = 0.0;
+    uint64_t simGenLast = generationOf();
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
 
-        life.step(GRID_W, GRID_H, numSpecies, speciesGrid);
+        if (!threaded) {
+            advance_engine(engine, opt.onCycle, gridW, gridH, numSpecies, speciesGrid);
+        }
 
-        colorizer.colorize(speciesGrid, rgba);
+        // Nothing is shown while minimized, so the grid stays on the device.
+        // With the sim thread running, this loop just sleeps until restored;
+        // without it, the loop keeps stepping the engine above.
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+            if (threaded) glfwWaitEventsTimeout(0.1);
+            tLast = std::chrono::high_resolution_clock::now();
+            continue;
+        }
 
-        renderer.updateTexture(GRID_W, GRID_H, rgba);
+        if (interop) {
+            glFinish();
+            std::unique_lock<std::mutex> lock;
+            if (threaded) lock = sim.pause();
+            interop = life.render_to_gl();
+            renderer.setIndexed(indexed && !interop);
+        }
+        if (!interop) {
+            const std::vector<unsigned char>* cells = &speciesGrid;
+            bool fresh = true;
+            if (threaded) {
+                // Asks for the next frame and takes whatever arrived
+                // since the last one, if anything.
+                sim.request_frame();
+                fresh = sim.fetch();
+                cells = &sim.latest().cells;
+            }
+            else {
+                engine->sync_host(speciesGrid);
+            }
+            if (fresh && indexed) {
+                renderer.updateSpecies(gridW, gridH, *cells);
+            }
+            else if (fresh) {
+                colorizer.colorize(*cells, rgba);
+                renderer.updateTexture(gridW, gridH, rgba);
+            }
+            else {
+                renderer.flush();
+            }
+        }
         renderer.draw();
 
         glfwSwapBuffers(window);
@@ -134,24 +678,112 @@ int main()
         fpsAccum += dt;
         fpsFrames += 1;
         if (fpsAccum >= 0.5) {
+            const uint64_t simGen = threaded ? sim.generation.load() : generationOf();
             fps = fpsFrames / fpsAccum;
+            simRate = (double)(simGen - simGenLast) / fpsAccum;
+            simGenLast = simGen;
             fpsAccum = 0.0;
             fpsFrames = 0;
         }
 
-        size_t global = life.workItems ? life.workItems : (size_t)GRID_N;
-        size_t local = life.localSize ? life.localSize : 0;
-
-        char title[256];
-        std::snprintf(title, sizeof(title),
-            "GoL | FPS: %.1f | Species: %u | GPU CUs: %u | Global: %zu | Local: %zu | Kernel: %.3f ms",
-            fps, numSpecies, life.computeUnits,
-            global, local, life.lastKernelMs);
+        // The engine stats below are written by the sim thread.
+        std::unique_lock<std::mutex> statsLock;
+        if (threaded) statsLock = sim.pause();
+
+        char title[320];
+        if (useHashLife) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Hashlife | Gen: %llu | Pop: %llu | Nodes: %zu | Step: %.3f ms",
+                fps, simRate, (unsigned long long)hashLife.generation,
+                (unsigned long long)hashLife.population,
+                hashLife.liveNodes, hashLife.lastStepMs);
+        }
+        else if (useSparse) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Sparse | Species: %u | Gen: %llu | Pop: %llu | Chunks: %zu | Threads: %u | Step: %.3f ms",
+                fps, simRate, numSpecies, (unsigned long long)sparseLife.generation,
+                (unsigned long long)sparseLife.population,
+                sparseLife.chunks.size(), sparseLife.pool.size(), sparseLife.lastStepMs);
+        }
+        else if (useSplit) {
+            int n = std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Split | Species: %u | Gen: %llu | Step: %.3f ms",
+                fps, simRate, numSpecies, (unsigned long long)splitLife.generation, splitLife.lastStepMs);
+            for (const CLSplitLife::Band& b : splitLife.bands) {
+                if (n < 0 || n >= (int)sizeof(title)) break;
+                n += std::snprintf(title + n, sizeof(title) - n, " | %s %u rows: %.3f ms",
+                    (b.type & CL_DEVICE_TYPE_GPU) ? "GPU" : (b.type & CL_DEVICE_TYPE_CPU) ? "CPU" : "ACC",
+                    b.rows(), b.lastKernelMs);
+            }
+        }
+        else if (useCpu) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | CPU %s | Species: %u | Threads: %u | Gen: %llu | Step: %.3f ms",
+                fps, simRate, CpuLife::isa_name(cpuLife.isa), numSpecies, cpuLife.pool.size(),
+                (unsigned long long)cpuLife.generation, cpuLife.lastStepMs);
+        }
+        else if (life.mode == LifeMode::Tiled) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Species: %u | GPU CUs: %u | Tile: %zux%zu | Kernel: %.3f ms",
+                fps, simRate, numSpecies, life.computeUnits,
+                life.tileW, life.tileH, life.lastKernelMs);
+        }
+        else if (life.mode == LifeMode::ActiveTiles) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Species: %u | GPU CUs: %u | Tile: %zux%zu | Kernel: %.3f ms | Active: %.1f%%",
+                fps, simRate, numSpecies, life.computeUnits,
+                life.tileW, life.tileH, life.lastKernelMs, life.lastActiveFraction * 100.0);
+        }
+        else if (life.mode == LifeMode::Temporal) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Species: %u | GPU CUs: %u | Gens/launch: %u | Tile: %ux%u | Kernel: %.3f ms",
+                fps, simRate, numSpecies, life.computeUnits,
+                life.temporalSteps, life.temporalTileW, life.temporalTileH, life.lastKernelMs);
+        }
+        else if (life.mode == LifeMode::BitPlanes) {
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Species: %u | GPU CUs: %u | Planes: %u x %u words/row | Kernel: %.3f ms",
+                fps, simRate, numSpecies, life.computeUnits,
+                numSpecies, life.wordsPerRow, life.lastKernelMs);
+        }
+        else {
+            size_t global = life.workItems ? life.workItems : (size_t)gridW * gridH;
+            size_t local = life.localSize ? life.localSize : 0;
+
+            std::snprintf(title, sizeof(title),
+                "GoL | FPS: %.1f | Sim: %.0f gen/s | Species: %u | GPU CUs: %u | Global: %zu | Local: %zu | Kernel: %.3f ms",
+                fps, simRate, numSpecies, life.computeUnits,
+                global, local, life.lastKernelMs);
+        }
+        if (engine == &life && life.collectStats) {
+            const size_t used = std::strlen(title);
+            std::snprintf(title + used, sizeof(title) - used,
+                " | Live: %u (+%llu/-%llu)", life.lastLiveCells,
+                (unsigned long long)life.lastBirths, (unsigned long long)life.lastDeaths);
+        }
+        if (engine->cycle_period()) {
+            const size_t used = std::strlen(title);
+            std::snprintf(title + used, sizeof(title) - used,
+                " | Cycle: p=%llu", (unsigned long long)engine->cycle_period());
+        }
+        if (!interop) {
+            const size_t used = std::strlen(title);
+            std::snprintf(title + used, sizeof(title) - used,
+                " | Upload: %.3f ms | Stall: %.3f ms",
+                renderer.lastUploadMs, renderer.lastStallMs);
+        }
+        if (statsLock.owns_lock()) statsLock.unlock();
         glfwSetWindowTitle(window, title);
     }
 
+    sim.stop();
+
+    if (useHashLife && !opt.saveMc.empty()) {
+        hashLife.save_mc(opt.saveMc);
+    }
+
     colorizer.shutdown();
-    life.shutdown();
+    engine->shutdown();
     renderer.shutdown();
 
     glfwDestroyWindow(window);
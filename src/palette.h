@@ -0,0 +1,57 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// RGBA palette with 256 entries indexed by species, shared by every
+// colorizer. Index 0 is dead (black); up to ten species get fixed classic
+// colors, and larger counts get evenly spaced hues so every species stays
+// distinct.
+inline void species_palette(uint32_t numSpecies, std::vector<unsigned char>& rgba)
+{
+    static const unsigned char classic[11][3] = {
+        {   0,   0,   0 }, { 255,   0,   0 }, {   0, 255,   0 }, {   0,   0, 255 },
+        { 255, 255,   0 }, { 255,   0, 255 }, {   0, 255, 255 }, { 255, 128,   0 },
+        { 128,   0, 255 }, {   0, 128, 255 }, { 255, 255, 255 }
+    };
+
+    rgba.assign(256 * 4, 255);
+    for (uint32_t i = 0; i < 256; ++i) {
+        unsigned char* px = rgba.data() + i * 4;
+
+        if (i == 0 || (numSpecies <= 10 && i <= 10)) {
+            px[0] = classic[i][0];
+            px[1] = classic[i][1];
+            px[2] = classic[i][2];
+            continue;
+        }
+        if (i > numSpecies) {
+            px[0] = px[1] = px[2] = 200;
+            continue;
+        }
+
+        // HSV with s = 0.85; even species drop to v = 0.8 so neighbors in
+        // hue also differ in brightness.
+        const float h = 6.0f * static_cast<float>(i - 1) / static_cast<float>(numSpecies);
+        const float v = (i & 1) ? 1.0f : 0.8f;
+        const float s = 0.85f;
+        const int   k = static_cast<int>(h) % 6;
+        const float f = h - std::floor(h);
+        const float p = v * (1.0f - s);
+        const float q = v * (1.0f - s * f);
+        const float t = v * (1.0f - s * (1.0f - f));
+
+        float r = v, g = t, b = p;
+        switch (k) {
+        case 1: r = q; g = v; b = p; break;
+        case 2: r = p; g = v; b = t; break;
+        case 3: r = p; g = q; b = v; break;
+        case 4: r = t; g = p; b = v; break;
+        case 5: r = v; g = p; b = q; break;
+        default: break;
+        }
+        px[0] = static_cast<unsigned char>(r * 255.0f + 0.5f);
+        px[1] = static_cast<unsigned char>(g * 255.0f + 0.5f);
+        px[2] = static_cast<unsigned char>(b * 255.0f + 0.5f);
+    }
+}
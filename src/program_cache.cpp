@@ -0,0 +1,200 @@
+#include "program_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+static std::mutex        cacheMutex;
+static std::string       cacheDir = "cl_cache";
+static ProgramCacheStats cacheStats;
+
+static const char     CACHE_MAGIC[4] = { 'G', 'O', 'L', 'P' };
+static const uint32_t CACHE_VERSION = 1;
+
+void set_program_cache_dir(const std::string& dir)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheDir = dir;
+}
+
+ProgramCacheStats program_cache_stats()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cacheStats;
+}
+
+static uint64_t fnv1a(const char* data, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static std::string hex64(uint64_t v)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+    return buf;
+}
+
+static std::string device_info(cl_device_id device, cl_device_info what)
+{
+    size_t size = 0;
+    if (clGetDeviceInfo(device, what, 0, nullptr, &size) != CL_SUCCESS || size == 0) return "";
+    std::string s(size, '\0');
+    clGetDeviceInfo(device, what, size, &s[0], nullptr);
+    s.resize(std::strlen(s.c_str()));
+    return s;
+}
+
+// The whole key is stored next to the binary, so a file-name collision
+// reads as a miss rather than loading the wrong program.
+static std::string cache_key(cl_device_id device, const char* source, const char* options)
+{
+    std::string key;
+    key += "device=" + device_info(device, CL_DEVICE_NAME) + "\n";
+    key += "vendor=" + device_info(device, CL_DEVICE_VENDOR) + "\n";
+    key += "driver=" + device_info(device, CL_DRIVER_VERSION) + "\n";
+    key += "version=" + device_info(device, CL_DEVICE_VERSION) + "\n";
+    key += "options=" + std::string(options) + "\n";
+    key += "source=" + hex64(fnv1a(source, std::strlen(source))) + "\n";
+    return key;
+}
+
+static std::string build_log(cl_program prog, cl_device_id device)
+{
+    size_t logSize = 0;
+    clGetProgramBuildInfo(prog, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
+    std::vector<char> log(logSize + 1, '\0');
+    clGetProgramBuildInfo(prog, device, CL_PROGRAM_BUILD_LOG, logSize, log.data(), nullptr);
+    return log.data();
+}
+
+static bool load_binary(const std::string& path, const std::string& key,
+    std::vector<unsigned char>& binary)
+{
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    char magic[4] = {};
+    uint32_t version = 0, keyLen = 0;
+    uint64_t size = 0;
+    bool ok = std::fread(magic, 1, 4, f) == 4
+        && std::memcmp(magic, CACHE_MAGIC, 4) == 0
+        && std::fread(&version, sizeof(version), 1, f) == 1 && version == CACHE_VERSION
+        && std::fread(&keyLen, sizeof(keyLen), 1, f) == 1 && keyLen == key.size();
+    if (ok) {
+        std::string stored(keyLen, '\0');
+        ok = std::fread(&stored[0], 1, keyLen, f) == keyLen && stored == key
+            && std::fread(&size, sizeof(size), 1, f) == 1 && size > 0;
+    }
+    if (ok) {
+        binary.resize(static_cast<size_t>(size));
+        ok = std::fread(binary.data(), 1, binary.size(), f) == binary.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+
+static void store_binary(const std::string& dir, const std::string& path,
+    const std::string& key, cl_program prog)
+{
+    size_t size = 0;
+    if (clGetProgramInfo(prog, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, nullptr) != CL_SUCCESS
+        || size == 0)
+        return;
+    std::vector<unsigned char> binary(size);
+    unsigned char* ptr = binary.data();
+    if (clGetProgramInfo(prog, CL_PROGRAM_BINARIES, sizeof(ptr), &ptr, nullptr) != CL_SUCCESS)
+        return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // Written aside and renamed over the entry, so a concurrent or
+    // interrupted run never sees half a binary.
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Warning: cannot write program cache " << tmp << "\n";
+        return;
+    }
+    const uint32_t keyLen = static_cast<uint32_t>(key.size());
+    const uint64_t size64 = size;
+    bool ok = std::fwrite(CACHE_MAGIC, 1, 4, f) == 4
+        && std::fwrite(&CACHE_VERSION, sizeof(CACHE_VERSION), 1, f) == 1
+        && std::fwrite(&keyLen, sizeof(keyLen), 1, f) == 1
+        && std::fwrite(key.data(), 1, key.size(), f) == key.size()
+        && std::fwrite(&size64, sizeof(size64), 1, f) == 1
+        && std::fwrite(binary.data(), 1, size, f) == size;
+    ok = (std::fclose(f) == 0) && ok;
+
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmp, ec);
+        std::cerr << "Warning: cannot write program cache " << path << "\n";
+    }
+}
+
+cl_program build_program(cl_context context, cl_device_id device,
+    const char* source, const char* options, std::string& log)
+{
+    using clock = std::chrono::steady_clock;
+    const clock::time_point t0 = clock::now();
+    if (!options) options = "";
+
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        dir = cacheDir;
+    }
+    const std::string key = dir.empty() ? std::string() : cache_key(device, source, options);
+    const std::string path = dir.empty() ? std::string()
+        : (std::filesystem::path(dir) / (hex64(fnv1a(key.data(), key.size())) + ".bin")).string();
+
+    cl_int err = CL_SUCCESS;
+    std::vector<unsigned char> binary;
+    if (!dir.empty() && load_binary(path, key, binary)) {
+        const unsigned char* ptr = binary.data();
+        const size_t size = binary.size();
+        cl_int status = CL_SUCCESS;
+        cl_program prog = clCreateProgramWithBinary(context, 1, &device, &size, &ptr, &status, &err);
+        if (err == CL_SUCCESS && status == CL_SUCCESS) {
+            err = clBuildProgram(prog, 1, &device, options, nullptr, nullptr);
+        }
+        if (err == CL_SUCCESS && status == CL_SUCCESS) {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            ++cacheStats.warm;
+            cacheStats.warmMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+            return prog;
+        }
+        if (prog) clReleaseProgram(prog);
+        std::cerr << "Warning: cached program " << path << " rejected, rebuilding\n";
+    }
+
+    const size_t len = std::strlen(source);
+    cl_program prog = clCreateProgramWithSource(context, 1, &source, &len, &err);
+    if (err != CL_SUCCESS) {
+        log = "clCreateProgramWithSource failed (err = " + std::to_string(err) + ")";
+        return nullptr;
+    }
+    err = clBuildProgram(prog, 1, &device, options, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        log = build_log(prog, device);
+        clReleaseProgram(prog);
+        return nullptr;
+    }
+
+    if (!dir.empty()) store_binary(dir, path, key, prog);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    ++cacheStats.cold;
+    cacheStats.coldMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    return prog;
+}
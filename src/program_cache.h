@@ -0,0 +1,26 @@
+#pragma once
+#define CL_TARGET_OPENCL_VERSION 200
+#include <CL/cl.h>
+#include <cstdint>
+#include <string>
+
+// Programs are built through an on-disk cache of device binaries
+// (CL_PROGRAM_BINARIES), keyed by device name, driver version, build options
+// and a hash of the source. Only the first run with a given key pays for
+// the compiler. Any change to the key misses and rebuilds from source, as
+// does a binary the driver refuses. An empty directory turns the cache off.
+struct ProgramCacheStats {
+    uint32_t cold = 0;      // built from source
+    uint32_t warm = 0;      // created from a cached binary
+    double   coldMs = 0.0;
+    double   warmMs = 0.0;
+};
+
+void set_program_cache_dir(const std::string& dir);
+ProgramCacheStats program_cache_stats();
+
+// clCreateProgramWithSource + clBuildProgram for a single device, or the
+// same from a cached binary. Returns null on failure with the build log in
+// `log`.
+cl_program build_program(cl_context context, cl_device_id device,
+    const char* source, const char* options, std::string& log);
@@ -1,5 +1,7 @@
 #include "renderer.h"
+#include "palette.h"
 #include <chrono>
+#include <cstring>
 
 static const char* VS_SRC = R"(
 #version 410 core
@@ -22,6 +24,20 @@ void main() {
 }
 )";
 
+// Indexed mode: one byte per cell, species mapped to color here instead of
+// by CLColorizer.
+static const char* FS_INDEXED_SRC = R"(
+#version 410 core
+in vec2 vUV;
+out vec4 FragColor;
+uniform usampler2D uSpecies;
+uniform sampler1D  uPalette;
+void main() {
+    uint s = texture(uSpecies, vUV).r;
+    FragColor = texelFetch(uPalette, int(s), 0);
+}
+)";
+
 static GLuint compile(GLenum t, const char* s) {
     GLuint sh = glCreateShader(t);
     glShaderSource(sh, 1, &s, nullptr);
@@ -29,9 +45,9 @@ static GLuint compile(GLenum t, const char* s) {
     return sh;
 }
 
-static GLuint makeProgram() {
+static GLuint makeProgram(const char* fs) {
     GLuint v = compile(GL_VERTEX_SHADER, VS_SRC);
-    GLuint f = compile(GL_FRAGMENT_SHADER, FS_SRC);
+    GLuint f = compile(GL_FRAGMENT_SHADER, fs);
     GLuint p = glCreateProgram();
     glAttachShader(p, v);
     glAttachShader(p, f);
@@ -72,13 +88,29 @@ bool Renderer::init(uint32_t w, uint32_t h)
         4 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    prog = makeProgram();
+    prog = makeProgram(FS_SRC);
     glUseProgram(prog);
     glUniform1i(glGetUniformLocation(prog, "uTex"), 0);
 
+    progIndexed = makeProgram(FS_INDEXED_SRC);
+    glUseProgram(progIndexed);
+    glUniform1i(glGetUniformLocation(progIndexed, "uSpecies"), 0);
+    glUniform1i(glGetUniformLocation(progIndexed, "uPalette"), 1);
+
+    glGenTextures(1, &speciesTex);
+    glBindTexture(GL_TEXTURE_2D, speciesTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI,
+        (GLsizei)w, (GLsizei)h,
+        0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &paletteTex);
+    setPalette(10);
+
     glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
         (GLsizei)w, (GLsizei)h,
         0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -87,21 +119,132 @@ bool Renderer::init(uint32_t w, uint32_t h)
     return true;
 }
 
-void Renderer::updateTexture(uint32_t w, uint32_t h,
-    const std::vector<unsigned char>& rgba)
+void Renderer::upload_slot(PboSlot& slot)
 {
-    glBindTexture(GL_TEXTURE_2D, tex);
+    if (!slot.pending) return;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buf);
+    glBindTexture(GL_TEXTURE_2D, slot.tex);
     glTexSubImage2D(GL_TEXTURE_2D, 0,
         0, 0,
-        (GLsizei)w, (GLsizei)h,
-        GL_RGBA, GL_UNSIGNED_BYTE,
-        rgba.data());
+        slot.w, slot.h,
+        slot.format, GL_UNSIGNED_BYTE,
+        nullptr);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.pending = false;
+}
+
+void Renderer::flush()
+{
+    PboSlot& prev = pbo[(pboNext + PBO_RING - 1) % PBO_RING];
+    if (!prev.pending) return;
+    upload_slot(prev);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void Renderer::stream(GLuint target, uint32_t w, uint32_t h, GLenum format,
+    const unsigned char* data, size_t bytes)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+    double stallMs = 0.0;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (!usePbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, target);
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+            0, 0,
+            (GLsizei)w, (GLsizei)h,
+            format, GL_UNSIGNED_BYTE,
+            data);
+    }
+    else {
+        PboSlot& slot = pbo[pboNext];
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        if (slot.fence) {
+            auto s0 = clock::now();
+            GLenum r = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            while (r == GL_TIMEOUT_EXPIRED) {
+                r = glClientWaitSync(slot.fence, 0, 1000000000ull);
+            }
+            // If the wait failed the slot may still be in use, so let the
+            // driver synchronize the map instead.
+            if (r == GL_WAIT_FAILED) access &= ~GL_MAP_UNSYNCHRONIZED_BIT;
+            stallMs = std::chrono::duration<double, std::milli>(clock::now() - s0).count();
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+
+        if (!slot.buf) glGenBuffers(1, &slot.buf);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buf);
+        if (slot.bytes != bytes) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_DRAW);
+            slot.bytes = bytes;
+        }
+
+        // Unless the wait failed, the fence guarantees the GPU is done with
+        // this slot, so the map skips the driver sync.
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes, access);
+        if (dst) {
+            std::memcpy(dst, data, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            slot.tex = target;
+            slot.format = format;
+            slot.w = (GLsizei)w;
+            slot.h = (GLsizei)h;
+            slot.pending = true;
+        }
+
+        upload_slot(pbo[(pboNext + PBO_RING - 1) % PBO_RING]);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pboNext = (pboNext + 1) % PBO_RING;
+    }
+
+    lastStallMs = stallMs;
+    lastUploadMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+}
+
+void Renderer::updateTexture(uint32_t w, uint32_t h,
+    const std::vector<unsigned char>& rgba)
+{
+    stream(tex, w, h, GL_RGBA, rgba.data(), static_cast<size_t>(w) * h * 4);
+}
+
+void Renderer::updateSpecies(uint32_t w, uint32_t h,
+    const std::vector<unsigned char>& species)
+{
+    stream(speciesTex, w, h, GL_RED_INTEGER, species.data(), static_cast<size_t>(w) * h);
+}
+
+void Renderer::setPalette(uint32_t numSpecies)
+{
+    std::vector<unsigned char> rgba;
+    species_palette(numSpecies, rgba);
+
+    glBindTexture(GL_TEXTURE_1D, paletteTex);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, 256,
+        0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
 void Renderer::draw()
 {
     glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(prog);
+    if (indexed) {
+        glUseProgram(progIndexed);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, paletteTex);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, speciesTex);
+    }
+    else {
+        glUseProgram(prog);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, tex);
+    }
     glBindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
@@ -113,10 +256,27 @@ void Renderer::setTitle(const std::string& s)
 
 void Renderer::shutdown()
 {
+    for (PboSlot& slot : pbo) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buf)   glDeleteBuffers(1, &slot.buf);
+        slot = PboSlot();
+    }
     if (tex) {
         glDeleteTextures(1, &tex);
         tex = 0;
     }
+    if (speciesTex) {
+        glDeleteTextures(1, &speciesTex);
+        speciesTex = 0;
+    }
+    if (paletteTex) {
+        glDeleteTextures(1, &paletteTex);
+        paletteTex = 0;
+    }
+    if (progIndexed) {
+        glDeleteProgram(progIndexed);
+        progIndexed = 0;
+    }
     if (vao) {
         glDeleteVertexArrays(1, &vao);
         vao = 0;
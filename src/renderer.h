@@ -6,13 +6,47 @@
 #include <string>
 
 struct Renderer {
+    // Pixel-unpack buffer ring: each frame is copied into a free slot and the
+    // texture is updated from the slot filled the frame before, with a fence
+    // per slot so it is not overwritten while the GPU still reads it.
+    static constexpr int PBO_RING = 3;
+    struct PboSlot {
+        GLuint  buf = 0;
+        GLsync  fence = nullptr;
+        size_t  bytes = 0;
+        GLuint  tex = 0;
+        GLenum  format = 0;
+        GLsizei w = 0;
+        GLsizei h = 0;
+        bool    pending = false;
+    };
+
     GLFWwindow* window = nullptr;
     GLuint      prog = 0;
     GLuint      vao = 0;
     GLuint      tex = 0;
+    GLuint      progIndexed = 0;
+    GLuint      speciesTex = 0;
+    GLuint      paletteTex = 0;
+    bool        indexed = false;
+    bool        usePbo = true;
+    PboSlot     pbo[PBO_RING];
+    int         pboNext = 0;
+    double      lastUploadMs = 0.0;
+    double      lastStallMs = 0.0;
 
     bool init(uint32_t w, uint32_t h);
     void updateTexture(uint32_t w, uint32_t h, const std::vector<unsigned char>& rgba);
+    void updateSpecies(uint32_t w, uint32_t h, const std::vector<unsigned char>& species);
+    void setPalette(uint32_t numSpecies);
+    void setIndexed(bool on) { indexed = on; }
+    void setPboStreaming(bool on) { usePbo = on; }
+    void stream(GLuint target, uint32_t w, uint32_t h, GLenum format,
+        const unsigned char* data, size_t bytes);
+    // Uploads the frame still waiting in its PBO slot, for frames that bring
+    // no new data and so never call stream().
+    void flush();
+    void upload_slot(PboSlot& slot);
     void draw();
     void setTitle(const std::string& s);
     void shutdown();
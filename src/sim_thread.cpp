@@ -0,0 +1,102 @@
+#include "sim_thread.h"
+#include <chrono>
+
+bool advance_engine(LifeEngine* e, CycleAction onCycle, uint32_t w, uint32_t h,
+    uint32_t numSpecies, std::vector<unsigned char>& grid)
+{
+    const uint64_t period = onCycle >= CycleAction::Stop ? e->cycle_period() : 0;
+    if (!period) {
+        e->step(w, h, numSpecies, grid);
+        return true;
+    }
+    if (onCycle == CycleAction::Skip) e->skip(period);
+    return false;
+}
+
+void SimThread::start(LifeEngine* e, uint32_t w, uint32_t h, uint32_t numSpecies,
+    const std::vector<unsigned char>& seed,
+    std::function<uint64_t()> gen, double gensPerSec,
+    CycleAction cycleAction)
+{
+    stop();
+
+    engine = e;
+    generationOf = std::move(gen);
+    grid = seed;
+    gridW = w;
+    gridH = h;
+    gridNS = numSpecies;
+    targetRate = gensPerSec > 0.0 ? gensPerSec : 0.0;
+    onCycle = cycleAction;
+
+    // The first frame is the seed itself so there is something to draw
+    // before the thread has produced anything.
+    const uint64_t g = generationOf ? generationOf() : 0;
+    frames.write_slot().cells = seed;
+    frames.write_slot().generation = g;
+    frames.publish();
+    generation.store(g, std::memory_order_relaxed);
+
+    running.store(true);
+    thread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop()
+{
+    running.store(false);
+    if (thread.joinable()) thread.join();
+}
+
+std::unique_lock<std::mutex> SimThread::pause()
+{
+    // The flag keeps run() from re-taking the mutex straight after
+    // releasing it, which would otherwise starve the caller.
+    pausing.store(true);
+    std::unique_lock<std::mutex> lock(engineMutex);
+    pausing.store(false);
+    return lock;
+}
+
+void SimThread::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    const uint64_t gen0 = generation.load(std::memory_order_relaxed);
+    const clock::time_point t0 = clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        uint64_t g = 0;
+        bool stepped = true;
+        {
+            std::lock_guard<std::mutex> lock(engineMutex);
+            stepped = advance_engine(engine, onCycle, gridW, gridH, gridNS, grid);
+            g = generationOf ? generationOf() : generation.load(std::memory_order_relaxed) + 1;
+
+            if (wantFrame.exchange(false, std::memory_order_relaxed)) {
+                engine->sync_host(grid);
+                Frame& f = frames.write_slot();
+                f.cells = grid;
+                f.generation = g;
+                frames.publish();
+            }
+        }
+        generation.store(g, std::memory_order_relaxed);
+
+        while (pausing.load()) std::this_thread::yield();
+
+        // A stopped or skipping cycle costs nothing to advance, so without
+        // a rate to hold it only polls for frame requests.
+        if (!stepped && (onCycle == CycleAction::Stop || targetRate <= 0.0)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Pace against the start time rather than the last step so that
+        // engines advancing several generations per step hold the rate too.
+        if (targetRate > 0.0) {
+            const double due = static_cast<double>(g - gen0) / targetRate;
+            std::this_thread::sleep_until(t0 + std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double>(due)));
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "life_engine.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What to do once the engine reports a cycle (LifeEngine::cycle_period).
+enum class CycleAction { Off, Report, Stop, Skip };
+
+// One step of the render or sim loop: steps the engine unless a cycle was
+// found and the action is Stop (nothing happens) or Skip (the generation
+// count moves on by one period). Returns whether the engine was stepped.
+bool advance_engine(LifeEngine* e, CycleAction onCycle, uint32_t w, uint32_t h,
+    uint32_t numSpecies, std::vector<unsigned char>& grid);
+
+// Runs an engine on its own thread so the simulation is not tied to the
+// swap interval. The grid is copied to the host only when the render loop
+// asks for one (request_frame) and handed over through a triple buffer.
+// Anything else that touches the engine from the render loop (CL/GL
+// interop, reading stats) goes through pause(), which holds it between
+// steps.
+struct SimThread {
+    struct Frame {
+        std::vector<unsigned char> cells;
+        uint64_t generation = 0;
+    };
+
+    LifeEngine* engine = nullptr;
+    std::function<uint64_t()> generationOf;
+    std::vector<unsigned char> grid;
+    uint32_t gridW = 0;
+    uint32_t gridH = 0;
+    uint32_t gridNS = 0;
+    double   targetRate = 0.0;
+    CycleAction onCycle = CycleAction::Report;
+
+    TripleBuffer<Frame>   frames;
+    std::thread           thread;
+    std::mutex            engineMutex;
+    std::atomic<bool>     running{ false };
+    std::atomic<bool>     wantFrame{ false };
+    std::atomic<bool>     pausing{ false };
+    std::atomic<uint64_t> generation{ 0 };
+
+    ~SimThread() { stop(); }
+
+    // `gensPerSec` of 0 steps as fast as the engine allows.
+    void start(LifeEngine* e, uint32_t w, uint32_t h, uint32_t numSpecies,
+        const std::vector<unsigned char>& seed,
+        std::function<uint64_t()> gen, double gensPerSec,
+        CycleAction cycleAction = CycleAction::Report);
+    void stop();
+
+    std::unique_lock<std::mutex> pause();
+
+    void request_frame() {
+        wantFrame.store(true, std::memory_order_relaxed);
+    }
+    bool fetch() {
+        return frames.fetch();
+    }
+    const Frame& latest() const {
+        return frames.read_slot();
+    }
+
+private:
+    void run();
+};
@@ -0,0 +1,223 @@
+#include "sparse_life.h"
+#include "life_rule.h"
+
+#include <chrono>
+#include <cstring>
+
+static const int C = SparseLife::CHUNK;
+
+static const int DX[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+static const int DY[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+
+enum : uint8_t {
+    EDGE_N = 1 << 0, EDGE_S = 1 << 1, EDGE_W = 1 << 2, EDGE_E = 1 << 3,
+    EDGE_NW = 1 << 4, EDGE_NE = 1 << 5, EDGE_SW = 1 << 6, EDGE_SE = 1 << 7
+};
+
+static uint64_t chunk_key(int64_t cx, int64_t cy)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32)
+        | static_cast<uint32_t>(cy);
+}
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static uint8_t edge_flags(const unsigned char* g)
+{
+    uint8_t e = 0;
+    for (int i = 0; i < C; ++i) {
+        if (g[i])                 e |= EDGE_N;
+        if (g[(C - 1) * C + i])   e |= EDGE_S;
+        if (g[i * C])             e |= EDGE_W;
+        if (g[i * C + C - 1])     e |= EDGE_E;
+    }
+    if (g[0])                     e |= EDGE_NW;
+    if (g[C - 1])                 e |= EDGE_NE;
+    if (g[(C - 1) * C])           e |= EDGE_SW;
+    if (g[C * C - 1])             e |= EDGE_SE;
+    return e;
+}
+
+bool SparseLife::init(uint32_t w, uint32_t h, uint32_t numSpecies, unsigned threads)
+{
+    (void)w;
+    (void)h;
+    (void)numSpecies;
+
+    chunks.clear();
+    live.clear();
+    pool.start(threads);
+
+    cur = 0;
+    seeded = false;
+    generation = 0;
+    population = 0;
+    peakChunks = 0;
+    lastStepMs = 0.0;
+    return true;
+}
+
+SparseLife::Chunk* SparseLife::find(int64_t cx, int64_t cy)
+{
+    auto it = chunks.find(chunk_key(cx, cy));
+    return it == chunks.end() ? nullptr : it->second.get();
+}
+
+SparseLife::Chunk* SparseLife::get_or_create(int64_t cx, int64_t cy)
+{
+    std::unique_ptr<Chunk>& slot = chunks[chunk_key(cx, cy)];
+    if (!slot) {
+        slot.reset(new Chunk());
+        slot->cx = cx;
+        slot->cy = cy;
+        std::memset(slot->cells, 0, sizeof(slot->cells));
+    }
+    return slot.get();
+}
+
+void SparseLife::seed(uint32_t w, uint32_t h, const std::vector<unsigned char>& host)
+{
+    for (uint32_t y = 0; y < h; ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+            size_t id = static_cast<size_t>(y) * w + x;
+            if (id >= host.size() || !host[id]) continue;
+
+            int64_t wx = viewX + x;
+            int64_t wy = viewY + y;
+            Chunk* c = get_or_create(floor_div(wx, C), floor_div(wy, C));
+            c->cells[cur][(wy - c->cy * C) * C + (wx - c->cx * C)] = host[id];
+        }
+    }
+
+    for (auto& kv : chunks) {
+        Chunk& c = *kv.second;
+        c.pop = 0;
+        for (int i = 0; i < C * C; ++i) c.pop += c.cells[cur][i] != 0;
+        c.edges = edge_flags(c.cells[cur]);
+    }
+}
+
+void SparseLife::step_chunk(Chunk& c, uint32_t numSpecies)
+{
+    unsigned char pad[(C + 2) * (C + 2)];
+    const int P = C + 2;
+    std::memset(pad, 0, sizeof(pad));
+
+    const unsigned char* g = c.cells[cur];
+    for (int y = 0; y < C; ++y)
+        std::memcpy(pad + (y + 1) * P + 1, g + y * C, C);
+
+    if (const Chunk* n = c.nbr[0]) std::memcpy(pad + 1, n->cells[cur] + (C - 1) * C, C);
+    if (const Chunk* n = c.nbr[1]) std::memcpy(pad + (C + 1) * P + 1, n->cells[cur], C);
+    if (const Chunk* n = c.nbr[2]) for (int y = 0; y < C; ++y) pad[(y + 1) * P] = n->cells[cur][y * C + C - 1];
+    if (const Chunk* n = c.nbr[3]) for (int y = 0; y < C; ++y) pad[(y + 1) * P + C + 1] = n->cells[cur][y * C];
+    if (const Chunk* n = c.nbr[4]) pad[0] = n->cells[cur][C * C - 1];
+    if (const Chunk* n = c.nbr[5]) pad[C + 1] = n->cells[cur][(C - 1) * C];
+    if (const Chunk* n = c.nbr[6]) pad[(C + 1) * P] = n->cells[cur][C - 1];
+    if (const Chunk* n = c.nbr[7]) pad[(C + 1) * P + C + 1] = n->cells[cur][0];
+
+    unsigned char* out = c.cells[cur ^ 1];
+    uint32_t pop = 0;
+    for (int y = 0; y < C; ++y) {
+        const unsigned char* r0 = pad + y * P;
+        const unsigned char* r1 = r0 + P;
+        const unsigned char* r2 = r1 + P;
+        for (int x = 0; x < C; ++x) {
+            unsigned char nb[8] = {
+                r0[x], r0[x + 1], r0[x + 2],
+                r1[x],            r1[x + 2],
+                r2[x], r2[x + 1], r2[x + 2]
+            };
+            unsigned char v = life_rule(r1[x + 1], nb, numSpecies);
+            out[y * C + x] = v;
+            pop += v != 0;
+        }
+    }
+
+    c.pop = pop;
+    c.edges = pop ? edge_flags(out) : 0;
+}
+
+void SparseLife::rasterize(uint32_t w, uint32_t h, std::vector<unsigned char>& host) const
+{
+    host.assign(static_cast<size_t>(w) * h, 0);
+
+    for (const auto& kv : chunks) {
+        const Chunk& c = *kv.second;
+        if (!c.pop) continue;
+
+        const int64_t x0 = c.cx * C - viewX;
+        const int64_t y0 = c.cy * C - viewY;
+        if (x0 >= w || y0 >= h || x0 + C <= 0 || y0 + C <= 0) continue;
+
+        for (int y = 0; y < C; ++y) {
+            int64_t hy = y0 + y;
+            if (hy < 0 || hy >= h) continue;
+            for (int x = 0; x < C; ++x) {
+                int64_t hx = x0 + x;
+                if (hx < 0 || hx >= w) continue;
+                host[static_cast<size_t>(hy) * w + static_cast<size_t>(hx)] = c.cells[cur][y * C + x];
+            }
+        }
+    }
+}
+
+void SparseLife::step(uint32_t w, uint32_t h, uint32_t numSpecies,
+    std::vector<unsigned char>& host)
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    if (!seeded) {
+        seed(w, h, host);
+        seeded = true;
+    }
+
+    live.clear();
+    for (auto& kv : chunks) live.push_back(kv.second.get());
+
+    for (Chunk* c : live) {
+        for (int d = 0; d < 8; ++d) {
+            if (c->edges & (1u << d)) get_or_create(c->cx + DX[d], c->cy + DY[d]);
+        }
+    }
+
+    live.clear();
+    for (auto& kv : chunks) {
+        Chunk* c = kv.second.get();
+        for (int d = 0; d < 8; ++d) c->nbr[d] = find(c->cx + DX[d], c->cy + DY[d]);
+        live.push_back(c);
+    }
+    if (chunks.size() > peakChunks) peakChunks = chunks.size();
+
+    pool.parallel_for(live.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) step_chunk(*live[i], numSpecies);
+    });
+
+    cur ^= 1;
+    ++generation;
+
+    population = 0;
+    for (auto it = chunks.begin(); it != chunks.end();) {
+        population += it->second->pop;
+        if (it->second->pop == 0) it = chunks.erase(it);
+        else ++it;
+    }
+    live.clear();
+
+    rasterize(w, h, host);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    lastStepMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void SparseLife::shutdown()
+{
+    pool.stop();
+    chunks.clear();
+    live.clear();
+    seeded = false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "life_engine.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Unbounded multi-species universe stored as 64x64 chunks in a hash map.
+// The w x h grid passed to step() is a viewport whose top-left cell sits
+// at world coordinate (viewX, viewY).
+struct SparseLife : LifeEngine {
+    static constexpr int CHUNK = 64;
+
+    struct Chunk {
+        int64_t       cx = 0;
+        int64_t       cy = 0;
+        unsigned char cells[2][CHUNK * CHUNK];
+        Chunk*        nbr[8];
+        uint32_t      pop = 0;
+        uint8_t       edges = 0;
+    };
+
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> chunks;
+    std::vector<Chunk*> live;
+    ThreadPool pool;
+
+    int      cur = 0;
+    bool     seeded = false;
+    int64_t  viewX = 0;
+    int64_t  viewY = 0;
+    uint64_t generation = 0;
+    uint64_t population = 0;
+    size_t   peakChunks = 0;
+    double   lastStepMs = 0.0;
+
+    bool init(uint32_t w, uint32_t h, uint32_t numSpecies, unsigned threads = 0);
+    void step(uint32_t w, uint32_t h, uint32_t numSpecies,
+        std::vector<unsigned char>& host) override;
+    void shutdown() override;
+
+    void set_view(int64_t x, int64_t y) {
+        viewX = x;
+        viewY = y;
+    }
+
+    Chunk* find(int64_t cx, int64_t cy);
+    Chunk* get_or_create(int64_t cx, int64_t cy);
+    void   seed(uint32_t w, uint32_t h, const std::vector<unsigned char>& host);
+    void   step_chunk(Chunk& c, uint32_t numSpecies);
+    void   rasterize(uint32_t w, uint32_t h, std::vector<unsigned char>& host) const;
+};
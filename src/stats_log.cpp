@@ -0,0 +1,123 @@
+#include "stats_log.h"
+#include <chrono>
+#include <iostream>
+
+static constexpr size_t STATS_LOG_BATCH = 256;
+
+static void put_le(std::vector<unsigned char>& out, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+}
+
+bool StatsLog::open(const std::string& path, uint32_t species)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open stats log " << path << "\n";
+        return false;
+    }
+    binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+    numSpecies = species;
+    records = 0;
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    if (binary) {
+        std::vector<unsigned char> header = { 'G', 'O', 'L', 'S' };
+        put_le(header, 1, 4);
+        put_le(header, numSpecies, 4);
+        std::fwrite(header.data(), 1, header.size(), file);
+    }
+    else {
+        std::fprintf(file, "generation");
+        for (const char* col : { "pop", "births", "deaths" }) {
+            for (uint32_t s = 1; s <= numSpecies; ++s) std::fprintf(file, ",%s_%u", col, s);
+        }
+        std::fprintf(file, "\n");
+    }
+
+    stopping = false;
+    writer = std::thread(&StatsLog::writer_loop, this);
+    return true;
+}
+
+void StatsLog::close()
+{
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+    if (file) std::fclose(file);
+    file = nullptr;
+}
+
+void StatsLog::append(uint64_t generation, uint32_t species, const int64_t* pop,
+    const int32_t* births, const int32_t* deaths)
+{
+    if (!file || species != numSpecies) return;
+
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        pending.push_back(generation);
+        for (uint32_t s = 1; s <= numSpecies; ++s) pending.push_back(static_cast<uint64_t>(pop[s]));
+        for (uint32_t s = 1; s <= numSpecies; ++s) pending.push_back(static_cast<uint32_t>(births[s]));
+        for (uint32_t s = 1; s <= numSpecies; ++s) pending.push_back(static_cast<uint32_t>(deaths[s]));
+        full = pending.size() >= STATS_LOG_BATCH * (1 + 3 * size_t(numSpecies));
+    }
+    ++records;
+    if (full) wake.notify_one();
+}
+
+void StatsLog::write_batch(const std::vector<uint64_t>& batch)
+{
+    const size_t stride = 1 + 3 * size_t(numSpecies);
+    if (binary) {
+        std::vector<unsigned char> out;
+        out.reserve(batch.size() / stride * (8 + 12 * size_t(numSpecies)));
+        for (size_t r = 0; r + stride <= batch.size(); r += stride) {
+            put_le(out, batch[r], 8);
+            for (size_t i = 1; i < stride; ++i) put_le(out, batch[r + i], 4);
+        }
+        std::fwrite(out.data(), 1, out.size(), file);
+        return;
+    }
+
+    char line[32];
+    for (size_t r = 0; r + stride <= batch.size(); r += stride) {
+        int n = std::snprintf(line, sizeof(line), "%llu", (unsigned long long)batch[r]);
+        std::fwrite(line, 1, n, file);
+        for (size_t i = 1; i < stride; ++i) {
+            // Populations are signed, births and deaths 32-bit.
+            n = (i <= numSpecies)
+                ? std::snprintf(line, sizeof(line), ",%lld", (long long)batch[r + i])
+                : std::snprintf(line, sizeof(line), ",%u", (unsigned)batch[r + i]);
+            std::fwrite(line, 1, n, file);
+        }
+        std::fputc('\n', file);
+    }
+}
+
+void StatsLog::writer_loop()
+{
+    std::vector<uint64_t> batch;
+    for (;;) {
+        bool done = false;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            wake.wait_for(lock, std::chrono::milliseconds(200),
+                [&] { return stopping || pending.size() >= STATS_LOG_BATCH * (1 + 3 * size_t(numSpecies)); });
+            batch.swap(pending);
+            done = stopping;
+        }
+        write_batch(batch);
+        batch.clear();
+        if (done) break;
+    }
+    std::fflush(file);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-generation species time series written by a background thread, so
+// append() only copies the record into a batch. A path ending in ".bin"
+// gets the binary format, anything else CSV:
+//   csv: generation,pop_1..pop_N,births_1..births_N,deaths_1..deaths_N
+//   bin: "GOLS" u32 version=1 u32 N, then per record u64 generation and
+//        N x u32 for each of pop, births, deaths (little-endian)
+struct StatsLog {
+    FILE*    file = nullptr;
+    bool     binary = false;
+    uint32_t numSpecies = 0;
+    uint64_t records = 0;
+
+    std::thread             writer;
+    std::mutex              m;
+    std::condition_variable wake;
+    std::vector<uint64_t>   pending;
+    bool                    stopping = false;
+
+    ~StatsLog() { close(); }
+
+    bool open(const std::string& path, uint32_t numSpecies);
+    void close();
+
+    // Arrays are indexed by species, 1..numSpecies.
+    void append(uint64_t generation, uint32_t numSpecies, const int64_t* pop,
+        const int32_t* births, const int32_t* deaths);
+
+private:
+    void write_batch(const std::vector<uint64_t>& batch);
+    void writer_loop();
+};
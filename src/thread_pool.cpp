@@ -0,0 +1,76 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+void ThreadPool::start(unsigned threads)
+{
+    stop();
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    stopping = false;
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) t.join();
+    workers.clear();
+}
+
+void ThreadPool::run_ranges()
+{
+    for (;;) {
+        size_t b = nextIndex.fetch_add(jobGrain);
+        if (b >= jobCount) break;
+        (*job)(b, std::min(b + jobGrain, jobCount));
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            wake.wait(lock, [&] { return stopping || jobId != seen; });
+            if (stopping) return;
+            seen = jobId;
+        }
+
+        run_ranges();
+
+        std::lock_guard<std::mutex> lock(m);
+        if (--busy == 0) done.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t, size_t)>& fn)
+{
+    if (count == 0) return;
+    if (workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m);
+        job = &fn;
+        jobCount = count;
+        jobGrain = std::max<size_t>(1, count / (size() * 4));
+        nextIndex = 0;
+        busy = workers.size();
+        ++jobId;
+    }
+    wake.notify_all();
+
+    run_ranges();
+
+    std::unique_lock<std::mutex> lock(m);
+    done.wait(lock, [&] { return busy == 0; });
+    job = nullptr;
+}
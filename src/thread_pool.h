@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex               m;
+    std::condition_variable  wake;
+    std::condition_variable  done;
+    std::atomic<size_t>      nextIndex{ 0 };
+
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    size_t   jobCount = 0;
+    size_t   jobGrain = 1;
+    size_t   busy = 0;
+    uint64_t jobId = 0;
+    bool     stopping = false;
+
+    ~ThreadPool() { stop(); }
+
+    void start(unsigned threads);
+    void stop();
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)>& fn);
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+private:
+    void run_ranges();
+    void worker_loop();
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Single-producer / single-consumer triple buffer. The writer fills
+// write_slot() and publish()es it, the reader fetch()es and then uses
+// read_slot(); neither side ever blocks, and the reader always gets the
+// newest published slot. The shared byte holds the index of the middle
+// slot plus a FRESH bit that says it has not been fetched yet.
+template <typename T>
+struct TripleBuffer {
+    static constexpr uint8_t FRESH = 0x4;
+    static constexpr uint8_t INDEX = 0x3;
+
+    T slots[3];
+    std::atomic<uint8_t> middle{ 1 };
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    T& write_slot() {
+        return slots[back];
+    }
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    bool fetch() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& read_slot() const {
+        return slots[front];
+    }
+};